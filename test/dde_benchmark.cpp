@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Measures DDE request and poke round trips between a server and a client
+// instance in the same process. Builds with MinGW and runs under Wine:
+//
+//   x86_64-w64-mingw32-g++ -std=c++14 -O2 -static dde_benchmark.cpp \
+//       ../win/dde.cpp ../win/string.cpp ../win/thread.cpp -luser32 \
+//       -o dde_benchmark.exe
+//   wine dde_benchmark.exe [transactions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <windows.h>
+
+#include "../win/dde.h"
+
+const wchar_t kService[] = L"DdeBenchmark";
+const wchar_t kTopic[] = L"Benchmark";
+const wchar_t kItem[] = L"Value";
+
+class Server : public win::DynamicDataExchange {
+public:
+  BOOL OnPoke(const std::wstring& topic, const std::wstring& item,
+              const std::wstring& data) {
+    return SetItemData(topic, item, data);
+  }
+};
+
+template <typename Function>
+bool Measure(const char* name, int count, Function function) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i) {
+    if (!function(i)) {
+      std::printf("%s failed at transaction %d\n", name, i);
+      return false;
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::printf("%-8s %8d transactions  %8.3f s  %10.0f per second\n",
+              name, count, elapsed.count(), count / elapsed.count());
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  const int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+  Server server;
+  if (!server.Initialize(APPCLASS_STANDARD, true) ||
+      !server.NameService(kService)) {
+    std::printf("Could not start the server\n");
+    return 1;
+  }
+  server.RegisterTopic(kTopic);
+  server.SetItemData(kTopic, kItem, L"0");
+
+  win::DynamicDataExchange client;
+  if (!client.Initialize(APPCLASS_STANDARD | APPCMD_CLIENTONLY, true) ||
+      !client.Connect(kService, kTopic)) {
+    std::printf("Could not connect to the server\n");
+    return 1;
+  }
+
+  std::wstring output;
+  bool success =
+      Measure("request", count, [&](int) {
+        return client.ClientTransaction(kItem, L"", &output,
+                                        XTYP_REQUEST) != FALSE;
+      }) &&
+      Measure("poke", count, [&](int i) {
+        return client.ClientTransaction(kItem, std::to_wstring(i), nullptr,
+                                        XTYP_POKE) != FALSE;
+      });
+
+  // The last poke must be visible to the next request
+  if (success) {
+    client.ClientTransaction(kItem, L"", &output, XTYP_REQUEST);
+    success = output == std::to_wstring(count - 1);
+    if (!success)
+      std::printf("Unexpected item data after poke\n");
+  }
+
+  client.Disconnect();
+  client.UnInitialize();
+  server.UnInitialize();
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks the batch rectangle operations against the rules of IntersectRect,
+// UnionRect and PtInRect, on fixed edge cases and on random input. The SSE2
+// path is selected at compile time, so the test is built twice, and the
+// scalar build undefines __SSE2__:
+//
+//   make geometry_test geometry_test_scalar
+//   ./geometry_test && ./geometry_test_scalar
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../win/geometry.h"
+
+namespace {
+
+#ifdef __SSE2__
+const char* const kPathName = "sse2";
+#else
+const char* const kPathName = "scalar";
+#endif
+
+std::mt19937 generator(42);
+int failures = 0;
+int checks = 0;
+
+void Check(bool condition, const char* name, size_t count) {
+  ++checks;
+  if (!condition) {
+    std::printf("FAIL: %s (%s, %u rects)\n", name, kPathName,
+                static_cast<unsigned>(count));
+    ++failures;
+  }
+}
+
+bool IsEqual(const RECT& a, const RECT& b) {
+  return a.left == b.left && a.top == b.top &&
+         a.right == b.right && a.bottom == b.bottom;
+}
+
+bool IsEmpty(const RECT& rect) {
+  return rect.right <= rect.left || rect.bottom <= rect.top;
+}
+
+// Reference implementations, written out from the user32 rules rather than
+// through win::Rect.
+
+bool ReferenceIntersect(const RECT& a, const RECT& b, RECT& output) {
+  const RECT result = {
+    a.left > b.left ? a.left : b.left,
+    a.top > b.top ? a.top : b.top,
+    a.right < b.right ? a.right : b.right,
+    a.bottom < b.bottom ? a.bottom : b.bottom,
+  };
+  if (IsEmpty(result)) {
+    output = RECT{0, 0, 0, 0};
+    return false;
+  }
+  output = result;
+  return true;
+}
+
+RECT ReferenceUnion(const RECT* rects, size_t count) {
+  RECT result = {0, 0, 0, 0};
+  bool found = false;
+  for (size_t i = 0; i < count; ++i) {
+    const RECT& rect = rects[i];
+    if (IsEmpty(rect))
+      continue;
+    if (!found) {
+      result = rect;
+      found = true;
+      continue;
+    }
+    if (rect.left < result.left) result.left = rect.left;
+    if (rect.top < result.top) result.top = rect.top;
+    if (rect.right > result.right) result.right = rect.right;
+    if (rect.bottom > result.bottom) result.bottom = rect.bottom;
+  }
+  return result;
+}
+
+size_t ReferenceFind(const RECT* rects, size_t count, const POINT& point) {
+  for (size_t i = 0; i < count; ++i) {
+    const RECT& rect = rects[i];
+    if (point.x >= rect.left && point.x < rect.right &&
+        point.y >= rect.top && point.y < rect.bottom)
+      return i;
+  }
+  return count;
+}
+
+void CheckIntersect(const std::vector<RECT>& rects, const RECT& clip) {
+  const size_t count = rects.size();
+  std::vector<RECT> output(count + 1, RECT{-1, -1, -1, -1});
+  const size_t result = win::IntersectRects(rects.data(), count, clip,
+                                            output.data());
+
+  size_t expected_result = 0;
+  bool same = true;
+  for (size_t i = 0; i < count; ++i) {
+    RECT expected;
+    if (ReferenceIntersect(rects[i], clip, expected))
+      ++expected_result;
+    same = same && IsEqual(output[i], expected);
+  }
+
+  Check(same, "IntersectRects output", count);
+  Check(result == expected_result, "IntersectRects count", count);
+  Check(IsEqual(output[count], RECT{-1, -1, -1, -1}),
+        "IntersectRects writes past the end", count);
+}
+
+void CheckUnion(const std::vector<RECT>& rects) {
+  const win::Rect result = win::UnionRects(rects.data(), rects.size());
+  Check(IsEqual(result, ReferenceUnion(rects.data(), rects.size())),
+        "UnionRects", rects.size());
+}
+
+void CheckFind(const std::vector<RECT>& rects, const POINT& point) {
+  Check(win::FindRectFromPoint(rects.data(), rects.size(), point) ==
+            ReferenceFind(rects.data(), rects.size(), point),
+        "FindRectFromPoint", rects.size());
+}
+
+void CheckEdgeCases() {
+  const RECT clip = {0, 0, 10, 10};
+  const std::vector<RECT> rects = {
+    {2, 2, 5, 5},      // Inside
+    {-5, -5, 15, 15},  // Covers the clip rectangle
+    {10, 0, 20, 10},   // Touches the right edge only
+    {0, 10, 10, 20},   // Touches the bottom edge only
+    {5, 5, 5, 8},      // Zero width
+    {8, 8, 3, 3},      // Inverted
+    {20, 20, 30, 30},  // Outside
+  };
+  CheckIntersect(rects, clip);
+
+  std::vector<RECT> output(rects.size());
+  const size_t result = win::IntersectRects(rects.data(), rects.size(), clip,
+                                            output.data());
+  Check(result == 2, "IntersectRects edge count", rects.size());
+  Check(IsEqual(output[1], clip), "IntersectRects covering", rects.size());
+  for (size_t i = 2; i < rects.size(); ++i)
+    Check(IsEqual(output[i], RECT{0, 0, 0, 0}),
+          "IntersectRects empty result is zeroed", rects.size());
+
+  // Empty rectangles do not extend the union, wherever they are
+  const std::vector<RECT> with_empty = {
+    {-100, -100, -100, 50}, {3, 4, 6, 8}, {90, 90, 80, 80}, {1, 6, 2, 7},
+  };
+  CheckUnion(with_empty);
+  Check(IsEqual(win::UnionRects(with_empty.data(), with_empty.size()),
+                RECT{1, 4, 6, 8}),
+        "UnionRects ignores empty rectangles", with_empty.size());
+
+  const std::vector<RECT> all_empty = {{5, 5, 5, 5}, {9, 1, 2, 3}};
+  Check(IsEqual(win::UnionRects(all_empty.data(), all_empty.size()),
+                RECT{0, 0, 0, 0}),
+        "UnionRects of empty rectangles", all_empty.size());
+  Check(IsEqual(win::UnionRects(nullptr, 0), RECT{0, 0, 0, 0}),
+        "UnionRects of nothing", 0);
+
+  // Left and top edges are inside, right and bottom edges are not
+  const std::vector<RECT> find = {{8, 8, 3, 3}, {0, 0, 4, 4}, {4, 0, 8, 4}};
+  Check(win::FindRectFromPoint(find.data(), find.size(), POINT{0, 0}) == 1,
+        "FindRectFromPoint top left edge", find.size());
+  Check(win::FindRectFromPoint(find.data(), find.size(), POINT{4, 2}) == 2,
+        "FindRectFromPoint right edge", find.size());
+  Check(win::FindRectFromPoint(find.data(), find.size(), POINT{2, 4}) ==
+            find.size(),
+        "FindRectFromPoint bottom edge", find.size());
+  Check(win::FindRectFromPoint(find.data(), find.size(), POINT{5, 5}) ==
+            find.size(),
+        "FindRectFromPoint inverted rectangle", find.size());
+  Check(win::FindRectFromPoint(nullptr, 0, POINT{0, 0}) == 0,
+        "FindRectFromPoint of nothing", 0);
+}
+
+// Coordinates come from a small range, so that many rectangles are empty,
+// inverted or share edges with each other and with the point.
+LONG RandomCoordinate() {
+  return static_cast<LONG>(generator() % 17) - 8;
+}
+
+RECT RandomRect() {
+  RECT rect;
+  rect.left = RandomCoordinate();
+  rect.top = RandomCoordinate();
+  rect.right = RandomCoordinate();
+  rect.bottom = RandomCoordinate();
+  return rect;
+}
+
+void CheckRandom() {
+  for (size_t count = 0; count <= 17; ++count) {
+    for (int round = 0; round < 200; ++round) {
+      std::vector<RECT> rects(count);
+      for (auto& rect : rects)
+        rect = RandomRect();
+
+      CheckIntersect(rects, RandomRect());
+      CheckUnion(rects);
+      CheckFind(rects, POINT{RandomCoordinate(), RandomCoordinate()});
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  CheckEdgeCases();
+  CheckRandom();
+
+  if (failures) {
+    std::printf("%d of %d checks failed (%s)\n", failures, checks, kPathName);
+    return 1;
+  }
+
+  std::printf("All %d checks passed (%s)\n", checks, kPathName);
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Measures adding 5,000 icons to an image list, one at a time with and
+// without preallocation, and in a single batch. Builds with MinGW and runs
+// under Wine or on Windows:
+//
+//   x86_64-w64-mingw32-g++ -std=c++14 -O2 -static imagelist_benchmark.cpp \
+//       ../win/ctrl/imagelist.cpp ../win/icon_cache.cpp ../win/surface.cpp \
+//       ../win/raster.cpp ../win/resample.cpp ../win/wic.cpp \
+//       ../win/handle.cpp ../win/thread.cpp -lcomctl32 -lgdi32 -luser32 \
+//       -lmsimg32 -lwindowscodecs -lole32 -o imagelist_benchmark.exe
+//   wine imagelist_benchmark.exe [count]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+#include <commctrl.h>
+
+#include "../win/common_controls.h"
+#include "../win/surface.h"
+
+const int kIconSize = 16;
+
+HICON CreateTestIcon() {
+  win::Surface surface;
+  surface.Create(kIconSize, kIconSize);
+  surface.Fill(win::Rect(0, 0, kIconSize, kIconSize), 0xFF3080C0);
+
+  std::vector<BYTE> mask_bits(((kIconSize + 15) / 16) * 2 * kIconSize);
+  HBITMAP mask = ::CreateBitmap(kIconSize, kIconSize, 1, 1, mask_bits.data());
+  HBITMAP color = surface.DetachBitmap();
+
+  ICONINFO info = {TRUE, 0, 0, mask, color};
+  HICON icon = ::CreateIconIndirect(&info);
+
+  ::DeleteObject(color);
+  ::DeleteObject(mask);
+
+  return icon;
+}
+
+bool Measure(const char* name, int count,
+             const std::function<bool(win::ImageList&)>& function) {
+  win::ImageList image_list;
+
+  const auto start = std::chrono::steady_clock::now();
+  const bool success = function(image_list);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (!success || image_list.GetImageCount() != count) {
+    std::printf("%-32s failed\n", name);
+    return false;
+  }
+
+  std::printf("%-32s %10.1f ms\n", name, elapsed.count());
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  const int count = argc > 1 ? std::atoi(argv[1]) : 5000;
+
+  HICON icon = CreateTestIcon();
+  if (!icon) {
+    std::printf("Could not create the icon\n");
+    return 1;
+  }
+
+  // Each surface holds a DC and a bitmap, so a few are shared to stay well
+  // below the GDI handle limit.
+  std::vector<std::unique_ptr<win::Surface>> surfaces;
+  for (int i = 0; i < 16; ++i) {
+    surfaces.emplace_back(new win::Surface);
+    surfaces.back()->Create(kIconSize, kIconSize);
+    surfaces.back()->Fill(win::Rect(0, 0, kIconSize, kIconSize),
+                          0xFF000000 | (i * 0x0F0A05));
+  }
+  std::vector<const win::Surface*> surface_pointers;
+  for (int i = 0; i < count; ++i)
+    surface_pointers.push_back(surfaces[i % surfaces.size()].get());
+
+  std::printf("Adding %d icons of %dx%d\n", count, kIconSize, kIconSize);
+
+  bool success =
+      Measure("AddIcon, no growth (before)", count,
+          [&](win::ImageList& image_list) {
+            if (!image_list.Create(kIconSize, kIconSize, 0, 0))
+              return false;
+            for (int i = 0; i < count; ++i)
+              image_list.AddIcon(icon);
+            return true;
+          }) &&
+      Measure("AddIcon, default growth", count,
+          [&](win::ImageList& image_list) {
+            if (!image_list.Create(kIconSize, kIconSize))
+              return false;
+            for (int i = 0; i < count; ++i)
+              image_list.AddIcon(icon);
+            return true;
+          }) &&
+      Measure("AddIcon, initial capacity", count,
+          [&](win::ImageList& image_list) {
+            if (!image_list.Create(kIconSize, kIconSize, count))
+              return false;
+            for (int i = 0; i < count; ++i)
+              image_list.AddIcon(icon);
+            return true;
+          }) &&
+      Measure("SetImageCount and ReplaceIcon", count,
+          [&](win::ImageList& image_list) {
+            if (!image_list.Create(kIconSize, kIconSize) ||
+                !image_list.SetImageCount(count))
+              return false;
+            for (int i = 0; i < count; ++i) {
+              if (image_list.ReplaceIcon(i, icon) != i)
+                return false;
+            }
+            return true;
+          }) &&
+      Measure("AddSurfaces", count,
+          [&](win::ImageList& image_list) {
+            return image_list.Create(kIconSize, kIconSize, count) &&
+                   image_list.AddSurfaces(surface_pointers) == 0;
+          });
+
+  ::DestroyIcon(icon);
+
+  return success ? 0 : 1;
+}
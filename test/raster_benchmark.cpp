@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Measures the raster kernels at each supported level on a 1920x1080 image:
+//
+//   make raster_benchmark && ./raster_benchmark
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "../win/raster.h"
+
+namespace {
+
+const char* const kLevelNames[] = {"scalar", "sse2", "avx2"};
+
+const int kWidth = 1920;
+const int kHeight = 1080;
+const ptrdiff_t kStride = kWidth * 4;
+
+// Runs the function until at least 200 ms have passed, and returns the
+// throughput in megapixels per second.
+double Measure(const std::function<void()>& function) {
+  using Clock = std::chrono::steady_clock;
+
+  int runs = 0;
+  const auto start = Clock::now();
+  std::chrono::duration<double> elapsed(0);
+  do {
+    function();
+    ++runs;
+    elapsed = Clock::now() - start;
+  } while (elapsed.count() < 0.2);
+
+  return static_cast<double>(kWidth) * kHeight * runs /
+         elapsed.count() / 1e6;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<uint32_t> src(kWidth * kHeight);
+  std::vector<uint32_t> dst(kWidth * kHeight);
+  std::vector<uint8_t> mask((kWidth / 8) * kHeight);
+
+  // Semi-transparent premultiplied pixels take the slowest paths
+  for (size_t i = 0; i < src.size(); ++i)
+    src[i] = 0x80000000 | ((i * 0x010203) & 0x007F7F7F);
+  for (size_t i = 0; i < mask.size(); ++i)
+    mask[i] = static_cast<uint8_t>(i * 37);
+
+  struct Benchmark {
+    const char* name;
+    std::function<void()> function;
+  };
+  const Benchmark benchmarks[] = {
+    {"fill", [&] {
+      win::FillPixels(dst.data(), kStride, kWidth, kHeight, 0x80402010);
+    }},
+    {"copy", [&] {
+      win::CopyPixels(dst.data(), kStride, src.data(), kStride,
+                      kWidth, kHeight);
+    }},
+    {"blend", [&] {
+      win::BlendPixels(dst.data(), kStride, src.data(), kStride,
+                       kWidth, kHeight);
+    }},
+    {"tint", [&] {
+      win::TintPixels(dst.data(), kStride, kWidth, kHeight, 0xFF8040C0);
+    }},
+    {"mask", [&] {
+      win::ExpandMask(dst.data(), kStride, mask.data(), kWidth / 8,
+                      kWidth, kHeight, 0xFFFFFFFF, 0xFF000000);
+    }},
+    {"premultiply", [&] {
+      win::PremultiplyPixels(dst.data(), kStride, src.data(), kStride,
+                             kWidth, kHeight);
+    }},
+    {"unpremultiply", [&] {
+      win::UnpremultiplyPixels(dst.data(), kStride, src.data(), kStride,
+                               kWidth, kHeight);
+    }},
+    {"swizzle", [&] {
+      win::SwizzlePixels(dst.data(), kStride, src.data(), kStride,
+                         kWidth, kHeight);
+    }},
+  };
+
+  std::printf("%-14s", "Mpixels/s");
+  for (int level = win::kRasterScalar; level <= win::kRasterAvx2; ++level)
+    std::printf("%10s", kLevelNames[level]);
+  std::printf("\n");
+
+  for (const auto& benchmark : benchmarks) {
+    std::printf("%-14s", benchmark.name);
+    for (int level = win::kRasterScalar; level <= win::kRasterAvx2; ++level) {
+      win::SetRasterLevel(static_cast<win::RasterLevel>(level));
+      if (win::GetRasterLevel() != level) {
+        std::printf("%10s", "-");
+        continue;
+      }
+      std::printf("%10.0f", Measure(benchmark.function));
+    }
+    std::printf("\n");
+  }
+
+  return 0;
+}
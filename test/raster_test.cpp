@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Compares the SSE2 and AVX2 raster kernels with the scalar ones on random
+// input. The kernels do not depend on Windows, so the test builds natively:
+//
+//   make raster_test && ./raster_test
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../win/raster.h"
+
+namespace {
+
+const char* const kLevelNames[] = {"scalar", "sse2", "avx2"};
+
+std::mt19937 generator(42);
+
+uint32_t Random() {
+  return static_cast<uint32_t>(generator());
+}
+
+uint32_t Premultiply(uint32_t pixel) {
+  const uint32_t alpha = pixel >> 24;
+  uint32_t result = pixel & 0xFF000000;
+  for (int shift = 0; shift < 24; shift += 8) {
+    const uint32_t channel = (pixel >> shift) & 0xFF;
+    result |= ((channel * alpha + 127) / 255) << shift;
+  }
+  return result;
+}
+
+// Random premultiplied pixels, with more fully transparent and fully opaque
+// ones than uniform input would have.
+uint32_t RandomPixel() {
+  const uint32_t pixel = Random();
+  switch (Random() % 4) {
+    case 0: return 0;
+    case 1: return pixel | 0xFF000000;
+    default: return Premultiply(pixel);
+  }
+}
+
+// The rows are padded, so that writes past the width are detected.
+struct Image {
+  Image(int width, int height)
+      : width(width),
+        height(height),
+        stride(width + 3),
+        pixels(static_cast<size_t>(stride) * height) {
+    for (auto& pixel : pixels)
+      pixel = RandomPixel();
+  }
+
+  uint32_t* data() { return pixels.data(); }
+  const uint32_t* data() const { return pixels.data(); }
+  ptrdiff_t bytes() const { return stride * 4; }
+
+  int width;
+  int height;
+  int stride;
+  std::vector<uint32_t> pixels;
+};
+
+typedef void (*Kernel)(Image& dst, const Image& src,
+                       const std::vector<uint8_t>& mask, uint32_t color);
+
+struct Test {
+  const char* name;
+  Kernel kernel;
+};
+
+const Test kTests[] = {
+  {"fill", [](Image& dst, const Image&, const std::vector<uint8_t>&,
+              uint32_t color) {
+    win::FillPixels(dst.data(), dst.bytes(), dst.width, dst.height, color);
+  }},
+  {"copy", [](Image& dst, const Image& src, const std::vector<uint8_t>&,
+              uint32_t) {
+    win::CopyPixels(dst.data(), dst.bytes(), src.data(), src.bytes(),
+                    dst.width, dst.height);
+  }},
+  {"blend", [](Image& dst, const Image& src, const std::vector<uint8_t>&,
+               uint32_t) {
+    win::BlendPixels(dst.data(), dst.bytes(), src.data(), src.bytes(),
+                     dst.width, dst.height);
+  }},
+  {"tint", [](Image& dst, const Image&, const std::vector<uint8_t>&,
+              uint32_t color) {
+    win::TintPixels(dst.data(), dst.bytes(), dst.width, dst.height, color);
+  }},
+  {"mask", [](Image& dst, const Image&, const std::vector<uint8_t>& mask,
+              uint32_t color) {
+    win::ExpandMask(dst.data(), dst.bytes(), mask.data(),
+                    (dst.width + 7) / 8, dst.width, dst.height,
+                    color, ~color);
+  }},
+  {"premultiply", [](Image& dst, const Image& src,
+                     const std::vector<uint8_t>&, uint32_t) {
+    // Straight alpha input may have any channel values
+    Image straight(src);
+    for (auto& pixel : straight.pixels)
+      pixel = Random();
+    win::PremultiplyPixels(dst.data(), dst.bytes(),
+                           straight.data(), straight.bytes(),
+                           dst.width, dst.height);
+  }},
+  {"unpremultiply", [](Image& dst, const Image& src,
+                       const std::vector<uint8_t>&, uint32_t) {
+    win::UnpremultiplyPixels(dst.data(), dst.bytes(),
+                             src.data(), src.bytes(),
+                             dst.width, dst.height);
+  }},
+  {"swizzle", [](Image& dst, const Image& src, const std::vector<uint8_t>&,
+                 uint32_t) {
+    win::SwizzlePixels(dst.data(), dst.bytes(), src.data(), src.bytes(),
+                       dst.width, dst.height);
+  }},
+};
+
+std::vector<win::RasterLevel> GetSupportedLevels() {
+  std::vector<win::RasterLevel> levels;
+  for (int level = win::kRasterScalar; level <= win::kRasterAvx2; ++level) {
+    win::SetRasterLevel(static_cast<win::RasterLevel>(level));
+    if (win::GetRasterLevel() == level)
+      levels.push_back(static_cast<win::RasterLevel>(level));
+  }
+  return levels;
+}
+
+}  // namespace
+
+int main() {
+  const auto levels = GetSupportedLevels();
+  int failures = 0;
+
+  for (const auto& test : kTests) {
+    int mismatches = 0;
+
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+      // Widths cover the vector loops and their remainders
+      const int width = static_cast<int>(Random() % 70) + 1;
+      const int height = static_cast<int>(Random() % 4) + 1;
+      const Image src(width, height);
+      const Image dst(width, height);
+      std::vector<uint8_t> mask(((width + 7) / 8) * height);
+      for (auto& bits : mask)
+        bits = static_cast<uint8_t>(Random());
+      const uint32_t color = Random();
+      const auto seed = Random();
+
+      std::vector<Image> results;
+      for (auto level : levels) {
+        win::SetRasterLevel(level);
+        generator.seed(seed);
+        results.push_back(dst);
+        test.kernel(results.back(), src, mask, color);
+      }
+
+      for (size_t i = 1; i < results.size(); ++i) {
+        if (results[i].pixels != results[0].pixels) {
+          if (mismatches++ == 0) {
+            std::printf("%s: %s differs from scalar (%dx%d)\n", test.name,
+                        kLevelNames[levels[i]], width, height);
+          }
+        }
+      }
+    }
+
+    std::printf("%-14s %s\n", test.name, mismatches ? "FAILED" : "ok");
+    failures += mismatches ? 1 : 0;
+  }
+
+  std::printf("levels tested:");
+  for (auto level : levels)
+    std::printf(" %s", kLevelNames[level]);
+  std::printf("\n");
+
+  return failures ? 1 : 0;
+}
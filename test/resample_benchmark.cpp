@@ -0,0 +1,143 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Measures resampling at each filter and supported SIMD level, and checks
+// that every level gives the same pixels as the scalar code:
+//
+//   make resample_benchmark && ./resample_benchmark [threads]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../win/raster.h"
+#include "../win/resample.h"
+
+namespace {
+
+const char* const kFilterNames[] = {"box", "bilinear", "lanczos"};
+const char* const kLevelNames[] = {"scalar", "sse2", "avx2"};
+
+struct Case {
+  const char* name;
+  int src_width;
+  int src_height;
+  int dst_width;
+  int dst_height;
+};
+
+const Case kCases[] = {
+  {"24 MP to thumbnail", 6000, 4000, 256, 171},
+  {"1080p to 720p", 1920, 1080, 1280, 720},
+  {"icon to 4x", 64, 64, 256, 256},
+};
+
+// A smooth gradient with varying alpha, premultiplied
+std::vector<uint32_t> CreateImage(int width, int height) {
+  std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint32_t alpha = 128 + (x + y) % 128;
+      const uint32_t red = (x * 255 / width) * alpha / 255;
+      const uint32_t green = (y * 255 / height) * alpha / 255;
+      const uint32_t blue = ((x ^ y) & 0xFF) * alpha / 255;
+      pixels[static_cast<size_t>(y) * width + x] =
+          (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+  }
+  return pixels;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int threads = argc > 1 ? std::atoi(argv[1]) : 0;
+  bool identical = true;
+
+  for (const auto& test : kCases) {
+    std::printf("%s (%dx%d to %dx%d), ms\n", test.name,
+                test.src_width, test.src_height,
+                test.dst_width, test.dst_height);
+    std::printf("%-10s", "");
+    for (int level = win::kRasterScalar; level <= win::kRasterAvx2; ++level)
+      std::printf("%10s", kLevelNames[level]);
+    std::printf("\n");
+
+    const auto src = CreateImage(test.src_width, test.src_height);
+    const ptrdiff_t src_stride = test.src_width * 4;
+    const ptrdiff_t dst_stride = test.dst_width * 4;
+
+    for (int filter = win::kResampleBox; filter <= win::kResampleLanczos;
+         ++filter) {
+      std::printf("%-10s", kFilterNames[filter]);
+      std::vector<uint32_t> reference;
+
+      for (int level = win::kRasterScalar; level <= win::kRasterAvx2;
+           ++level) {
+        win::SetRasterLevel(static_cast<win::RasterLevel>(level));
+        if (win::GetRasterLevel() != level) {
+          std::printf("%10s", "-");
+          continue;
+        }
+
+        std::vector<uint32_t> dst(
+            static_cast<size_t>(test.dst_width) * test.dst_height);
+
+        // The fastest of a few runs
+        double best = 0.0;
+        for (int run = 0; run < 3; ++run) {
+          const auto start = std::chrono::steady_clock::now();
+          win::ResamplePixels(dst.data(), dst_stride,
+                              test.dst_width, test.dst_height,
+                              src.data(), src_stride,
+                              test.src_width, test.src_height,
+                              static_cast<win::ResampleFilter>(filter),
+                              threads);
+          const std::chrono::duration<double, std::milli> elapsed =
+              std::chrono::steady_clock::now() - start;
+          if (run == 0 || elapsed.count() < best)
+            best = elapsed.count();
+        }
+
+        if (reference.empty()) {
+          reference = dst;
+        } else if (dst != reference) {
+          identical = false;
+          std::printf("%9.1f*", best);
+          continue;
+        }
+        std::printf("%10.1f", best);
+      }
+      std::printf("\n");
+    }
+    std::printf("\n");
+  }
+
+  if (!identical)
+    std::printf("* differs from the scalar result\n");
+
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks that TextLayoutCache ignores DT_WORDBREAK when there is no width to
+// wrap lines to. Builds with MinGW and runs under Wine or on Windows:
+//
+//   x86_64-w64-mingw32-g++ -std=c++14 -O2 -static text_layout_test.cpp \
+//       ../win/text_layout.cpp -lgdi32 -lusp10 -o text_layout_test.exe
+//   wine text_layout_test.exe
+
+#include <cstdio>
+#include <string>
+
+#include <windows.h>
+
+#include "../win/text_layout.h"
+
+bool IsSameLayout(const win::TextLayout& a, const win::TextLayout& b) {
+  return a.text == b.text &&
+         a.extent.cx == b.extent.cx && a.extent.cy == b.extent.cy &&
+         a.line_starts == b.line_starts;
+}
+
+bool Check(HDC hdc, const std::wstring& text, int width) {
+  // Separate caches, so that both layouts are measured with DrawText
+  win::TextLayoutCache plain_cache;
+  win::TextLayoutCache wrapped_cache;
+
+  const win::TextLayout& plain = plain_cache.Measure(hdc, text, 0, 0);
+  const win::TextLayout& wrapped =
+      wrapped_cache.Measure(hdc, text, width, DT_WORDBREAK);
+  if (IsSameLayout(plain, wrapped))
+    return true;
+
+  std::printf("FAIL: width %d, %d lines (%ldx%ld), expected %d (%ldx%ld)\n",
+              width,
+              static_cast<int>(wrapped.line_starts.size()),
+              wrapped.extent.cx, wrapped.extent.cy,
+              static_cast<int>(plain.line_starts.size()),
+              plain.extent.cx, plain.extent.cy);
+  return false;
+}
+
+int main() {
+  HDC hdc = ::CreateCompatibleDC(nullptr);
+  ::SelectObject(hdc, ::GetStockObject(DEFAULT_GUI_FONT));
+
+  const std::wstring texts[] = {
+    L"",
+    L"word",
+    L"several words on a single line",
+    L"two lines\r\nof several words",
+  };
+
+  int failures = 0;
+  for (const auto& text : texts) {
+    if (!Check(hdc, text, 0))
+      ++failures;
+    if (!Check(hdc, text, -10))
+      ++failures;
+  }
+
+  ::DeleteDC(hdc);
+
+  if (failures) {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}
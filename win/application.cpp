@@ -22,6 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <utility>
+
 #include <windows.h>
 #include <commctrl.h>
 #include <uxtheme.h>
@@ -37,9 +39,14 @@ App::App() {
 }
 
 App::~App() {
+  RunExitHandlers();
   window_map.Clear();
 }
 
+void App::AddExitHandler(std::function<void()> handler) {
+  exit_handlers_.push_back(std::move(handler));
+}
+
 BOOL App::InitCommonControls(DWORD flags) const {
   INITCOMMONCONTROLSEX icc;
   icc.dwSize = sizeof(INITCOMMONCONTROLSEX);
@@ -55,7 +62,14 @@ BOOL App::InitInstance() {
 int App::MessageLoop() {
   MSG msg;
 
-  while (::GetMessage(&msg, nullptr, 0, 0)) {
+  while (true) {
+    // WM_PAINT is only generated once the queue is empty, so deferred
+    // invalidations are flushed before each wait.
+    Window::FlushInvalidations();
+
+    if (!::GetMessage(&msg, nullptr, 0, 0))
+      break;
+
     BOOL processed = FALSE;
     if ((msg.message >= WM_KEYFIRST && msg.message <= WM_KEYLAST) ||
         (msg.message >= WM_MOUSEFIRST && msg.message <= WM_MOUSELAST)) {
@@ -83,12 +97,24 @@ void App::PostQuitMessage(int exit_code) {
 }
 
 int App::Run() {
+  int result = -1;
+
   if (InitInstance()) {
-    return MessageLoop();
+    result = MessageLoop();
   } else {
     ::PostQuitMessage(-1);
-    return -1;
   }
+
+  RunExitHandlers();
+  return result;
+}
+
+void App::RunExitHandlers() {
+  std::vector<std::function<void()>> handlers;
+  handlers.swap(exit_handlers_);
+
+  for (auto it = handlers.rbegin(); it != handlers.rend(); ++it)
+    (*it)();
 }
 
 std::wstring App::GetCurrentDirectory() const {
@@ -24,7 +24,9 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include <windows.h>
 
@@ -35,6 +37,9 @@ public:
   App();
   virtual ~App();
 
+  // Exit handlers are called in reverse order once the message loop has
+  // ended, e.g. to stop a SettingsStore so that pending changes are written.
+  void AddExitHandler(std::function<void()> handler);
   BOOL InitCommonControls(DWORD flags) const;
 
   virtual BOOL InitInstance();
@@ -48,6 +53,9 @@ public:
   BOOL SetCurrentDirectory(const std::wstring& directory);
 
 private:
+  void RunExitHandlers();
+
+  std::vector<std::function<void()>> exit_handlers_;
   HINSTANCE instance_;
 };
 
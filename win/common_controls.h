@@ -24,7 +24,10 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <windows.h>
@@ -35,6 +38,8 @@ SOFTWARE.
 
 namespace win {
 
+class Surface;
+
 ////////////////////////////////////////////////////////////////////////////////
 // ComboBox
 
@@ -98,8 +103,12 @@ public:
   void operator=(const HIMAGELIST image_list);
 
   int        AddBitmap(HBITMAP bitmap, COLORREF mask);
+  int        AddIcon(HICON icon);
+  int        AddIcon(HINSTANCE instance, int resource);
+  int        AddStrip(HBITMAP bitmap, HBITMAP mask = nullptr);
+  int        AddSurfaces(const std::vector<const Surface*>& surfaces);
   BOOL       BeginDrag(int track, int hotspot_x, int hotspot_y);
-  BOOL       Create(int cx, int cy);
+  BOOL       Create(int cx, int cy, int initial = 0, int grow = 32);
   VOID       Destroy();
   BOOL       DragEnter(HWND hwnd_lock, int x, int y);
   BOOL       DragLeave(HWND hwnd_lock);
@@ -110,24 +119,75 @@ public:
   HIMAGELIST GetHandle();
   HICON      GetIcon(int index);
   BOOL       GetIconSize(int& cx, int& cy);
+  int        GetImageCount();
   BOOL       Remove(int index);
+  BOOL       Replace(int index, HBITMAP bitmap, HBITMAP mask = nullptr);
+  BOOL       Replace(int index, const Surface& surface);
+  int        ReplaceIcon(int index, HICON icon);
   VOID       SetHandle(HIMAGELIST image_list);
+  BOOL       SetImageCount(UINT count);
 
 private:
+  void RemoveResourceIndex(int index);
+
   HIMAGELIST image_list_;
+  std::map<std::pair<HINSTANCE, int>, int> resource_indices_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // List view
 
+// Provides the items of a list view with the LVS_OWNERDATA style, which only
+// keeps the item count and selection state.
+class ListViewDataSource {
+public:
+  virtual ~ListViewDataSource() {}
+
+  virtual void   GetItemText(int item, int subitem, LPWSTR output, int max_length) = 0;
+  virtual int    GetItemImage(int item, int subitem) { return I_IMAGENONE; }
+  virtual LPARAM GetItemParam(int item) { return 0; }
+
+  // Called before the items in the range are displayed, so that they can be
+  // loaded at once.
+  virtual void   CacheHint(int from, int to) {}
+  // Returns the index of the matching item, or -1 if there is none.
+  virtual int    FindItem(int start, const LVFINDINFO& find_info) { return -1; }
+  // Moves the item at order[i] to position i, e.g. after ListView::SortByKeys.
+  virtual void   Reorder(const std::vector<int>& order) {}
+};
+
 class ListView : public Window {
 public:
+  // Sort types that SortByKeys understands without a key function. Text is
+  // compared by collation key, ignoring case and comparing digits as numbers.
+  // Numbers are parsed from the start of the text, and text that is not a
+  // number sorts after all numbers. Other types sort as text.
+  enum SortType {
+    kSortText = 0,
+    kSortNumber
+  };
+
   struct SortOptions {
     int column = -1;
     int order = 1;
     int type = 0;
   };
 
+  // Either a collation key (see GetSortKey) or a number
+  struct SortKey {
+    std::string text;
+    double number = 0.0;
+  };
+  typedef std::function<SortKey(int item, const SortOptions& options)> SortKeyFunction;
+
+  // The text of each column, with the first one being the item text
+  struct Row {
+    std::vector<std::wstring> text;
+    int group = -1;
+    int image = -1;
+    LPARAM param = 0;
+  };
+
   ListView();
   ListView(HWND hwnd);
   virtual ~ListView() {}
@@ -143,6 +203,7 @@ public:
   BOOL       GetColumnOrderArray(int count, int* array);
   int        GetCountPerPage();
   HWND       GetHeader();
+  ListViewDataSource* GetDataSource();
   int        GetItemCount();
   int        GetItemGroup(int i);
   LPARAM     GetItemParam(int i);
@@ -164,6 +225,7 @@ public:
   int        InsertGroup(int index, LPCWSTR text, bool collapsable = false, bool collapsed = false);
   int        InsertItem(const LVITEM& lvi);
   int        InsertItem(int index, int nGroup, int icon, UINT column_count, PUINT columns, LPCWSTR text, LPARAM lParam);
+  int        InsertRows(int index, const std::vector<Row>& rows);
   BOOL       IsGroupViewEnabled();
   UINT       IsItemVisible(UINT index);
   BOOL       RedrawItems(int first, int last, bool repaint);
@@ -173,12 +235,14 @@ public:
   BOOL       SetBkImage(HBITMAP bitmap, ULONG flags = LVBKIF_TYPE_WATERMARK, int offset_x = 100, int offset_y = 100);
   void       SetCheckState(int index, BOOL check);
   BOOL       SetColumnOrderArray(int count, int* order_array);
+  void       SetDataSource(ListViewDataSource* data_source);
   BOOL       SetColumnWidth(int column, int cx);
   void       SetExtendedStyle(DWORD ex_style);
   int        SetGroupText(int index, LPCWSTR text);
   DWORD      SetHoverTime(DWORD hover_time);
   void       SetImageList(HIMAGELIST image_list, int type = LVSIL_SMALL);
   BOOL       SetItem(int index, int subitem, LPCWSTR text);
+  BOOL       SetItemCountEx(int count, DWORD flags = LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
   BOOL       SetItemIcon(int index, int icon);
   BOOL       SetItemIcon(int index, int subitem, int icon);
   BOOL       SetItemParam(int index, LPARAM lParam);
@@ -189,12 +253,19 @@ public:
   int        SetView(DWORD view);
   void       Sort(int column, int order, int type, PFNLVCOMPARE compare);
   void       Sort(PFNLVCOMPARE compare);
+  void       SortByKeys(int column, int order, int type, const SortKeyFunction& get_key = nullptr);
 
 protected:
   virtual void PreCreate(CREATESTRUCT &cs);
   virtual void OnCreate(HWND hwnd, LPCREATESTRUCT create_struct);
+  virtual BOOL OnReflectedNotify(LPNMHDR nmh, LRESULT& result);
 
 private:
+  void    ApplyOrder(const std::vector<int>& order);
+  SortKey GetTextSortKey(int item, const SortOptions& options);
+
+  bool applying_order_;
+  ListViewDataSource* data_source_;
   std::pair<SortOptions, SortOptions> sort_;
 };
 
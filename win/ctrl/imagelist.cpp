@@ -23,9 +23,39 @@ SOFTWARE.
 */
 
 #include "../common_controls.h"
+#include "../icon_cache.h"
+#include "../raster.h"
+#include "../surface.h"
 
 namespace win {
 
+// Copies the surfaces side by side into a single bitmap, each clipped to the
+// image size. Image lists expect straight alpha.
+HBITMAP CreateStrip(const Surface* const* surfaces, size_t count,
+                    int cx, int cy) {
+  Surface strip;
+  if (!strip.Create(cx * static_cast<int>(count), cy))
+    return nullptr;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!surfaces[i])
+      continue;
+    const SIZE size = surfaces[i]->GetSize();
+    const Rect source(0, 0, size.cx < cx ? size.cx : cx,
+                      size.cy < cy ? size.cy : cy);
+    strip.Copy(cx * static_cast<int>(i), 0, *surfaces[i], source);
+  }
+
+  UnpremultiplyPixels(strip.GetPixels(), strip.GetStride(),
+                      strip.GetPixels(), strip.GetStride(),
+                      cx * static_cast<int>(count), cy);
+
+  // The bitmap cannot be added while it is selected into the surface's DC
+  return strip.DetachBitmap();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ImageList::ImageList()
     : image_list_(nullptr) {
 }
@@ -38,10 +68,11 @@ void ImageList::operator=(const HIMAGELIST image_list) {
   SetHandle(image_list);
 }
 
-BOOL ImageList::Create(int cx, int cy) {
+BOOL ImageList::Create(int cx, int cy, int initial, int grow) {
   Destroy();
 
-  image_list_ = ::ImageList_Create(cx, cy, ILC_COLOR32 | ILC_MASK, 0, 0);
+  image_list_ = ::ImageList_Create(cx, cy, ILC_COLOR32 | ILC_MASK,
+                                   initial, grow);
 
   return image_list_ != nullptr;
 }
@@ -51,6 +82,8 @@ VOID ImageList::Destroy() {
     ::ImageList_Destroy(image_list_);
     image_list_ = nullptr;
   }
+
+  resource_indices_.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +96,59 @@ int ImageList::AddBitmap(HBITMAP bitmap, COLORREF mask) {
   }
 }
 
+int ImageList::AddIcon(HICON icon) {
+  return ::ImageList_ReplaceIcon(image_list_, -1, icon);
+}
+
+// Resource icons are added once, at the size of the list. The image list
+// keeps its own copy, so the cached icon is released right away.
+int ImageList::AddIcon(HINSTANCE instance, int resource) {
+  const auto key = std::make_pair(instance, resource);
+  auto it = resource_indices_.find(key);
+  if (it != resource_indices_.end())
+    return it->second;
+
+  int cx = 0, cy = 0;
+  if (!GetIconSize(cx, cy))
+    return -1;
+
+  HICON icon = GetIconCache().Load(instance, resource, cx, cy);
+  if (!icon)
+    return -1;
+
+  int index = AddIcon(icon);
+  ReleaseIcon(icon);
+
+  if (index > -1)
+    resource_indices_[key] = index;
+
+  return index;
+}
+
+// A bitmap that is wider than the image size is split into multiple images,
+// which are added at once.
+int ImageList::AddStrip(HBITMAP bitmap, HBITMAP mask) {
+  return ::ImageList_Add(image_list_, bitmap, mask);
+}
+
+int ImageList::AddSurfaces(const std::vector<const Surface*>& surfaces) {
+  if (surfaces.empty())
+    return -1;
+
+  int cx = 0, cy = 0;
+  if (!GetIconSize(cx, cy))
+    return -1;
+
+  HBITMAP bitmap = CreateStrip(surfaces.data(), surfaces.size(), cx, cy);
+  if (!bitmap)
+    return -1;
+
+  int index = AddStrip(bitmap);
+  ::DeleteObject(bitmap);
+
+  return index;
+}
+
 BOOL ImageList::BeginDrag(int track, int hotspot_x, int hotspot_y) {
   return ::ImageList_BeginDrag(image_list_, track, hotspot_x, hotspot_y);
 }
@@ -105,8 +191,60 @@ BOOL ImageList::GetIconSize(int& cx, int& cy) {
   return ::ImageList_GetIconSize(image_list_, &cx, &cy);
 }
 
+int ImageList::GetImageCount() {
+  return ::ImageList_GetImageCount(image_list_);
+}
+
 BOOL ImageList::Remove(int index) {
-  return ::ImageList_Remove(image_list_, index);
+  if (!::ImageList_Remove(image_list_, index))
+    return FALSE;
+
+  // Removing an image shifts the ones that follow it
+  for (auto it = resource_indices_.begin(); it != resource_indices_.end();) {
+    if (index == -1 || it->second == index) {
+      it = resource_indices_.erase(it);
+    } else {
+      if (it->second > index)
+        it->second--;
+      ++it;
+    }
+  }
+
+  return TRUE;
+}
+
+// Replacing an image also replaces the resource icon that was added there.
+// Replace(int, const Surface&) goes through this overload as well.
+BOOL ImageList::Replace(int index, HBITMAP bitmap, HBITMAP mask) {
+  if (!::ImageList_Replace(image_list_, index, bitmap, mask))
+    return FALSE;
+
+  RemoveResourceIndex(index);
+  return TRUE;
+}
+
+BOOL ImageList::Replace(int index, const Surface& surface) {
+  int cx = 0, cy = 0;
+  if (!GetIconSize(cx, cy))
+    return FALSE;
+
+  const Surface* surfaces[] = {&surface};
+  HBITMAP bitmap = CreateStrip(surfaces, 1, cx, cy);
+  if (!bitmap)
+    return FALSE;
+
+  BOOL result = Replace(index, bitmap);
+  ::DeleteObject(bitmap);
+
+  return result;
+}
+
+int ImageList::ReplaceIcon(int index, HICON icon) {
+  const int result = ::ImageList_ReplaceIcon(image_list_, index, icon);
+  if (result > -1 && index > -1)
+    RemoveResourceIndex(index);
+
+  return result;
 }
 
 VOID ImageList::SetHandle(HIMAGELIST image_list) {
@@ -115,4 +253,33 @@ VOID ImageList::SetHandle(HIMAGELIST image_list) {
   image_list_ = image_list;
 }
 
-}  // namespace win
\ No newline at end of file
+// Allocates room for all images at once, which can then be filled with
+// Replace. Images beyond the new count are removed.
+BOOL ImageList::SetImageCount(UINT count) {
+  if (!::ImageList_SetImageCount(image_list_, count))
+    return FALSE;
+
+  for (auto it = resource_indices_.begin(); it != resource_indices_.end();) {
+    if (it->second >= static_cast<int>(count)) {
+      it = resource_indices_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ImageList::RemoveResourceIndex(int index) {
+  for (auto it = resource_indices_.begin(); it != resource_indices_.end();) {
+    if (it->second == index) {
+      it = resource_indices_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace win
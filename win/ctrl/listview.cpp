@@ -22,13 +22,24 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <cwchar>
+#include <numeric>
+#include <unordered_map>
+
 #include "../common_controls.h"
+#include "../sort.h"
+#include "../string.h"
 
 namespace win {
 
-ListView::ListView() {}
+ListView::ListView()
+    : applying_order_(false),
+      data_source_(nullptr) {
+}
 
-ListView::ListView(HWND hwnd) {
+ListView::ListView(HWND hwnd)
+    : applying_order_(false),
+      data_source_(nullptr) {
   SetWindowHandle(hwnd);
 }
 
@@ -38,6 +49,8 @@ void ListView::PreCreate(CREATESTRUCT &cs) {
   cs.style = WS_CHILD | WS_TABSTOP | WS_VISIBLE |
              LVS_ALIGNLEFT | LVS_AUTOARRANGE | LVS_REPORT |
              LVS_SHAREIMAGELISTS | LVS_SINGLESEL;
+  if (data_source_)
+    cs.style |= LVS_OWNERDATA;
 }
 
 void ListView::OnCreate(HWND hwnd, LPCREATESTRUCT create_struct) {
@@ -47,6 +60,51 @@ void ListView::OnCreate(HWND hwnd, LPCREATESTRUCT create_struct) {
   Window::OnCreate(hwnd, create_struct);
 }
 
+// Items of a virtual list view are requested from the data source as they are
+// displayed. The notifications are only received if the control is mapped,
+// i.e. created or attached rather than constructed from a handle.
+BOOL ListView::OnReflectedNotify(LPNMHDR nmh, LRESULT& result) {
+  // Parameters that are temporarily replaced while sorting are not model data
+  if (applying_order_ &&
+      (nmh->code == LVN_ITEMCHANGING || nmh->code == LVN_ITEMCHANGED)) {
+    result = 0;
+    return TRUE;
+  }
+
+  if (!data_source_)
+    return FALSE;
+
+  switch (nmh->code) {
+    case LVN_GETDISPINFO: {
+      LVITEM& item = reinterpret_cast<NMLVDISPINFO*>(nmh)->item;
+      if ((item.mask & LVIF_TEXT) && item.pszText && item.cchTextMax > 0) {
+        item.pszText[0] = L'\0';
+        data_source_->GetItemText(item.iItem, item.iSubItem,
+                                  item.pszText, item.cchTextMax);
+      }
+      if (item.mask & LVIF_IMAGE)
+        item.iImage = data_source_->GetItemImage(item.iItem, item.iSubItem);
+      if (item.mask & LVIF_PARAM)
+        item.lParam = data_source_->GetItemParam(item.iItem);
+      result = 0;
+      return TRUE;
+    }
+    case LVN_ODCACHEHINT: {
+      auto hint = reinterpret_cast<LPNMLVCACHEHINT>(nmh);
+      data_source_->CacheHint(hint->iFrom, hint->iTo);
+      result = 0;
+      return TRUE;
+    }
+    case LVN_ODFINDITEM: {
+      auto find = reinterpret_cast<LPNMLVFINDITEM>(nmh);
+      result = data_source_->FindItem(find->iStart, find->lvfi);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int ListView::InsertColumn(int index, int width, int width_min, int align,
@@ -140,6 +198,10 @@ HWND ListView::GetHeader() {
   return ListView_GetHeader(window_);
 }
 
+ListViewDataSource* ListView::GetDataSource() {
+  return data_source_;
+}
+
 int ListView::GetItemCount() {
   return ListView_GetItemCount(window_);
 }
@@ -262,6 +324,83 @@ int ListView::InsertItem(int item, int group, int image, UINT column_count,
   return ListView_InsertItem(window_, &lvi);
 }
 
+// Inserts the rows at the index, or at the end if the index is out of range.
+// Redrawing and column autosizing are suspended until all rows are inserted,
+// as is group view unless the rows are assigned to groups. Returns the index
+// of the first row, or -1 if none could be inserted.
+int ListView::InsertRows(int index, const std::vector<Row>& rows) {
+  if (rows.empty())
+    return -1;
+
+  RedrawGuard redraw_guard(window_);
+
+  const int count = GetItemCount();
+  if (index < 0 || index > count)
+    index = count;
+
+  // Allocates memory for all items at once
+  ListView_SetItemCount(window_, count + static_cast<int>(rows.size()));
+
+  const bool autosize = (ListView_GetExtendedListViewStyle(window_) &
+                         LVS_EX_AUTOSIZECOLUMNS) != 0;
+  if (autosize)
+    ListView_SetExtendedListViewStyleEx(window_, LVS_EX_AUTOSIZECOLUMNS, 0);
+
+  bool grouped = false;
+  for (const auto& row : rows) {
+    if (row.group > -1) {
+      grouped = true;
+      break;
+    }
+  }
+  const bool group_view = !grouped && IsGroupViewEnabled();
+  if (group_view)
+    EnableGroupView(false);
+
+  int first = -1;
+  for (const auto& row : rows) {
+    LVITEM lvi = {0};
+    lvi.mask = LVIF_TEXT | LVIF_PARAM;
+    lvi.iItem = index;
+    lvi.lParam = row.param;
+    lvi.pszText = const_cast<LPWSTR>(row.text.empty() ?
+                                     L"" : row.text.front().c_str());
+    if (row.group > -1) {
+      lvi.mask |= LVIF_GROUPID;
+      lvi.iGroupId = row.group;
+    }
+    if (row.image > -1) {
+      lvi.mask |= LVIF_IMAGE;
+      lvi.iImage = row.image;
+    }
+
+    const int item = ListView_InsertItem(window_, &lvi);
+    if (item == -1)
+      break;
+    if (first == -1)
+      first = item;
+
+    // Subitems are empty by default
+    for (size_t i = 1; i < row.text.size(); ++i) {
+      if (!row.text[i].empty()) {
+        ListView_SetItemText(window_, item, static_cast<int>(i),
+                             const_cast<LPWSTR>(row.text[i].c_str()));
+      }
+    }
+
+    index = item + 1;
+  }
+
+  if (group_view)
+    EnableGroupView(true);
+  if (autosize) {
+    ListView_SetExtendedListViewStyleEx(window_, LVS_EX_AUTOSIZECOLUMNS,
+                                        LVS_EX_AUTOSIZECOLUMNS);
+  }
+
+  return first;
+}
+
 UINT ListView::IsItemVisible(UINT index) {
   return ListView_IsItemVisible(window_, index);
 }
@@ -312,6 +451,12 @@ BOOL ListView::SetColumnWidth(int column, int cx) {
   return ListView_SetColumnWidth(window_, column, cx);
 }
 
+// The data source must be set before the control is created, as the
+// LVS_OWNERDATA style cannot be changed afterwards.
+void ListView::SetDataSource(ListViewDataSource* data_source) {
+  data_source_ = data_source;
+}
+
 void ListView::SetExtendedStyle(DWORD ex_style) {
   ListView_SetExtendedListViewStyle(window_, ex_style);
 }
@@ -334,6 +479,12 @@ BOOL ListView::SetItem(int index, int subitem, LPCWSTR text) {
   return ListView_SetItem(window_, &lvi);
 }
 
+// The item count of a virtual list view is set instead of inserting items.
+// By default, the scroll position is kept and only the new items are redrawn.
+BOOL ListView::SetItemCountEx(int count, DWORD flags) {
+  return ListView_SetItemCountEx(window_, count, flags);
+}
+
 BOOL ListView::SetItemIcon(int index, int icon) {
   LVITEM lvi = {0};
   lvi.iImage = icon;
@@ -434,4 +585,158 @@ void ListView::Sort(PFNLVCOMPARE compare) {
   ListView_SortItemsEx(window_, compare, this);
 }
 
+typedef std::unordered_map<LPARAM, int> SortRanks;
+
+int CALLBACK CompareSortRanks(LPARAM lParam1, LPARAM lParam2,
+                              LPARAM lParamSort) {
+  const auto& ranks = *reinterpret_cast<const SortRanks*>(lParamSort);
+  const int rank1 = ranks.find(lParam1)->second;
+  const int rank2 = ranks.find(lParam2)->second;
+  return rank1 < rank2 ? -1 : (rank1 > rank2 ? 1 : 0);
+}
+
+int CALLBACK CompareRankParams(LPARAM lParam1, LPARAM lParam2, LPARAM) {
+  return lParam1 < lParam2 ? -1 : (lParam1 > lParam2 ? 1 : 0);
+}
+
+int CompareSortKeys(const ListView::SortKey& a, const ListView::SortKey& b) {
+  const int result = a.text.compare(b.text);
+  if (result != 0)
+    return result;
+  return a.number < b.number ? -1 : (a.number > b.number ? 1 : 0);
+}
+
+// Keys are computed once for each item, rather than in every comparison
+// through the control. Both the primary and secondary sort options are
+// honored, and items that compare equal keep their current order.
+void ListView::SortByKeys(int column, int order, int type,
+                          const SortKeyFunction& get_key) {
+  if (sort_.first.column != column)
+    std::swap(sort_.first, sort_.second);
+
+  sort_.first.column = column;
+  sort_.first.order = (order == 0) ? 1 : order;
+  sort_.first.type = type;
+
+  const int count = GetItemCount();
+  if (count < 2)
+    return;
+
+  const SortOptions* options[] = {&sort_.first, &sort_.second};
+  const size_t key_count = sort_.second.column > -1 &&
+                           sort_.second.column != column ? 2 : 1;
+
+  std::vector<SortKey> keys(count * key_count);
+  for (int i = 0; i < count; ++i) {
+    for (size_t k = 0; k < key_count; ++k) {
+      keys[i * key_count + k] = get_key ?
+          get_key(i, *options[k]) : GetTextSortKey(i, *options[k]);
+    }
+  }
+
+  std::vector<int> indices(count);
+  std::iota(indices.begin(), indices.end(), 0);
+
+  ParallelStableSort(indices.begin(), indices.end(),
+      [&](int a, int b) {
+        for (size_t k = 0; k < key_count; ++k) {
+          const int result = CompareSortKeys(keys[a * key_count + k],
+                                             keys[b * key_count + k]);
+          if (result != 0)
+            return options[k]->order > 0 ? result < 0 : result > 0;
+        }
+        return false;
+      });
+
+  ApplyOrder(indices);
+}
+
+// A virtual list view only keeps the selection, which is moved along with the
+// items. Otherwise, the control sorts by the rank of each item's parameter,
+// without calling back into the model.
+void ListView::ApplyOrder(const std::vector<int>& order) {
+  const int count = static_cast<int>(order.size());
+
+  if (data_source_) {
+    std::vector<int> selected;
+    for (int i = GetNextItem(-1, LVNI_SELECTED); i > -1;
+         i = GetNextItem(i, LVNI_SELECTED)) {
+      selected.push_back(i);
+    }
+    const int focused = GetNextItem(-1, LVNI_FOCUSED);
+
+    data_source_->Reorder(order);
+
+    std::vector<int> positions(count);
+    for (int i = 0; i < count; ++i)
+      positions[order[i]] = i;
+
+    if (!selected.empty()) {
+      SelectAllItems(false);
+      for (int index : selected)
+        SelectItem(positions[index]);
+    }
+    if (focused > -1 && focused < count)
+      SetItemState(positions[focused], LVIS_FOCUSED, LVIS_FOCUSED);
+
+    RedrawItems(0, count - 1, true);
+    return;
+  }
+
+  std::vector<LPARAM> params(count);
+  for (int i = 0; i < count; ++i)
+    params[i] = GetItemParam(i);
+
+  SortRanks ranks;
+  ranks.reserve(count);
+  for (int i = 0; i < count; ++i)
+    ranks.emplace(params[order[i]], i);
+
+  if (static_cast<int>(ranks.size()) == count) {
+    ListView_SortItems(window_, CompareSortRanks,
+                       reinterpret_cast<LPARAM>(&ranks));
+    return;
+  }
+
+  // Parameters that are not unique cannot tell the items apart, so each item
+  // holds its rank instead while sorting. The parent is not notified of these
+  // changes, provided that the control is mapped (see OnReflectedNotify).
+  applying_order_ = true;
+
+  for (int i = 0; i < count; ++i)
+    SetItemParam(order[i], i);
+
+  ListView_SortItems(window_, CompareRankParams, 0);
+
+  for (int i = 0; i < count; ++i)
+    SetItemParam(i, params[order[i]]);
+
+  applying_order_ = false;
+}
+
+ListView::SortKey ListView::GetTextSortKey(int item,
+                                           const SortOptions& options) {
+  std::wstring text;
+
+  if (data_source_) {
+    std::vector<wchar_t> buffer(MAX_PATH);
+    data_source_->GetItemText(item, options.column, &buffer[0], MAX_PATH);
+    text.assign(&buffer[0]);
+  } else {
+    GetItemText(item, options.column, text);
+  }
+
+  SortKey key;
+  if (options.type == kSortNumber) {
+    wchar_t* end = nullptr;
+    key.number = std::wcstod(text.c_str(), &end);
+    if (end != text.c_str())
+      return key;
+    key.number = 0.0;
+  }
+
+  key.text = GetSortKey(text);
+  return key;
+}
+
 }  // namespace win
@@ -22,17 +22,26 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "dde.h"
 #include "string.h"
+#include "thread.h"
 
 namespace win {
 
+// DDEML does not pass the instance to the callback, so servers are looked up
+// by service name when a client connects.
+std::vector<DynamicDataExchange*> dde_instances;
+CriticalSection dde_instances_section;
+
 DynamicDataExchange::DynamicDataExchange()
     : conversation_(nullptr),
       instance_(0),
-      is_unicode_(false) {
+      is_unicode_(false),
+      thread_id_(0) {
 }
 
 DynamicDataExchange::~DynamicDataExchange() {
@@ -51,69 +60,311 @@ BOOL DynamicDataExchange::Initialize(DWORD afCmd, bool unicode) {
     ::DdeInitializeA(&instance_, DdeCallback, afCmd, 0);
   }
 
+  if (instance_) {
+    thread_id_ = ::GetCurrentThreadId();
+    Lock lock(dde_instances_section);
+    dde_instances.push_back(this);
+  }
+
   return instance_ != 0;
 }
 
 void DynamicDataExchange::UnInitialize() {
   if (instance_) {
+    AbandonTransactions();
+    DisconnectAll();
+    FreeItemData();
+    FreeStringHandles();
     ::DdeUninitialize(instance_);
     instance_ = 0;
+
+    Lock lock(dde_instances_section);
+    dde_instances.erase(std::remove(dde_instances.begin(), dde_instances.end(),
+                                    this),
+                        dde_instances.end());
   }
+
+  services_.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 BOOL DynamicDataExchange::Connect(const std::wstring& service,
                                   const std::wstring& topic) {
-  if (!instance_)
-    return FALSE;
-
-  HSZ hszService = CreateStringHandle(service);
-  HSZ hszTopic = CreateStringHandle(topic);
-
-  conversation_ = ::DdeConnect(instance_, hszService, hszTopic, NULL);
-
-  FreeStringHandle(hszTopic);
-  FreeStringHandle(hszService);
-
+  Disconnect();
+  conversation_ = ConnectConversation(service, topic);
   return conversation_ != nullptr;
 }
 
 void DynamicDataExchange::Disconnect() {
   if (conversation_) {
+    FailTransactions(conversation_);
     ::DdeDisconnect(conversation_);
     conversation_ = nullptr;
   }
 }
 
+HCONV DynamicDataExchange::GetConversation(const std::wstring& service,
+                                           const std::wstring& topic) {
+  if (!instance_)
+    return nullptr;
+
+  auto& conversation = conversations_[std::make_pair(service, topic)];
+
+  if (conversation && !IsConnected(conversation)) {
+    HCONV reconnected = ::DdeReconnect(conversation);
+    if (reconnected) {
+      ::DdeSetUserHandle(reconnected, QID_SYNC,
+                         reinterpret_cast<DWORD_PTR>(this));
+    } else {
+      ::DdeDisconnect(conversation);
+    }
+    conversation = reconnected;
+  }
+
+  if (!conversation)
+    conversation = ConnectConversation(service, topic);
+
+  return conversation;
+}
+
+void DynamicDataExchange::DisconnectAll() {
+  for (const auto& it : conversations_) {
+    if (it.second) {
+      FailTransactions(it.second);
+      ::DdeDisconnect(it.second);
+    }
+  }
+  conversations_.clear();
+
+  Disconnect();
+}
+
+HCONV DynamicDataExchange::ConnectConversation(const std::wstring& service,
+                                               const std::wstring& topic) {
+  if (!instance_)
+    return nullptr;
+
+  HSZ hszService = GetStringHandle(service);
+  HSZ hszTopic = GetStringHandle(topic);
+
+  HCONV conversation = ::DdeConnect(instance_, hszService, hszTopic, NULL);
+
+  // Lets the callback find the owner of the conversation
+  if (conversation)
+    ::DdeSetUserHandle(conversation, QID_SYNC,
+                       reinterpret_cast<DWORD_PTR>(this));
+
+  return conversation;
+}
+
+bool DynamicDataExchange::IsConnected(HCONV conversation) {
+  CONVINFO ci = {0};
+  ci.cb = sizeof(CONVINFO);
+  if (!::DdeQueryConvInfo(conversation, QID_SYNC, &ci))
+    return false;
+  return (ci.wStatus & ST_CONNECTED) != 0;
+}
+
+DynamicDataExchange* DynamicDataExchange::FromConversation(HCONV conversation) {
+  CONVINFO ci = {0};
+  ci.cb = sizeof(CONVINFO);
+  if (!conversation || !::DdeQueryConvInfo(conversation, QID_SYNC, &ci))
+    return nullptr;
+  return reinterpret_cast<DynamicDataExchange*>(ci.hUser);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 BOOL DynamicDataExchange::ClientTransaction(const std::wstring& item,
                                             const std::wstring& data,
                                             std::wstring* output,
-                                            UINT wType) {
+                                            UINT wType,
+                                            DWORD timeout) {
+  return ClientTransaction(conversation_, item, data, output, wType, timeout);
+}
+
+BOOL DynamicDataExchange::ClientTransaction(HCONV conversation,
+                                            const std::wstring& item,
+                                            const std::wstring& data,
+                                            std::wstring* output,
+                                            UINT wType,
+                                            DWORD timeout) {
   DWORD dwResult = 0;
-  HSZ hszItem = wType != XTYP_EXECUTE ? CreateStringHandle(item) : nullptr;
+  HDDEDATA hData = Transact(conversation, item, data, wType, timeout,
+                            &dwResult);
+
+  if (output)
+    output->clear();
+
+  // Only request transactions return a data handle, which we own
+  if (hData && wType == XTYP_REQUEST) {
+    if (output) {
+      DWORD size = 0;
+      const BYTE* bytes = ::DdeAccessData(hData, &size);
+      if (bytes) {
+        output->assign(DecodeText(bytes, size));
+        ::DdeUnaccessData(hData);
+      }
+    }
+    ::DdeFreeDataHandle(hData);
+  }
+
+  return hData != 0;
+}
+
+BOOL DynamicDataExchange::ClientTransactionAsync(const std::wstring& item,
+                                                 const std::wstring& data,
+                                                 UINT wType,
+                                                 TransactionCallback callback) {
+  return ClientTransactionAsync(conversation_, item, data, wType, callback);
+}
+
+BOOL DynamicDataExchange::ClientTransactionAsync(HCONV conversation,
+                                                 const std::wstring& item,
+                                                 const std::wstring& data,
+                                                 UINT wType,
+                                                 TransactionCallback callback) {
+  DWORD id = 0;
+  if (!Transact(conversation, item, data, wType, TIMEOUT_ASYNC, &id))
+    return FALSE;
+
+  // XTYP_XACT_COMPLETE cannot arrive before we return to the message loop
+  transactions_[std::make_pair(conversation, id)] = std::move(callback);
+  return TRUE;
+}
+
+void DynamicDataExchange::AbandonTransactions(HCONV conversation) {
+  if (!instance_)
+    return;
+
+  ::DdeAbandonTransaction(instance_, conversation, 0);
+
+  if (conversation) {
+    FailTransactions(conversation);
+  } else {
+    std::vector<TransactionCallback> callbacks;
+    for (auto& it : transactions_)
+      callbacks.push_back(std::move(it.second));
+    transactions_.clear();
+    for (auto& callback : callbacks)
+      if (callback)
+        callback(FALSE, nullptr, 0);
+  }
+}
+
+HDDEDATA DynamicDataExchange::Transact(HCONV conversation,
+                                       const std::wstring& item,
+                                       const std::wstring& data,
+                                       UINT wType, DWORD timeout,
+                                       LPDWORD result) {
+  if (!instance_ || !conversation)
+    return nullptr;
+
+  HSZ hszItem = wType != XTYP_EXECUTE ? GetStringHandle(item) : nullptr;
+
+  // Data is only sent with execute and poke transactions
+  std::string buffer;
+  if (wType == XTYP_EXECUTE || wType == XTYP_POKE)
+    EncodeText(data, buffer);
 
   HDDEDATA hData = ::DdeClientTransaction(
-      is_unicode_ ? (LPBYTE)data.data() : (LPBYTE)WstrToStr(data).data(),
-      is_unicode_ ? (data.size() + 1) * sizeof(WCHAR) : data.size() + 1,
-      conversation_,
+      buffer.empty() ? nullptr : (LPBYTE)buffer.data(),
+      static_cast<DWORD>(buffer.size()),
+      conversation,
       hszItem,
-      is_unicode_ ? CF_UNICODETEXT : CF_TEXT,
+      GetFormat(),
       wType,
-      3000,
-      &dwResult);
+      timeout,
+      result);
+
+  return hData;
+}
+
+void DynamicDataExchange::CompleteTransaction(HCONV conversation, DWORD id,
+                                              HDDEDATA hdata) {
+  auto it = transactions_.find(std::make_pair(conversation, id));
+  if (it == transactions_.end())
+    return;
+
+  TransactionCallback callback = std::move(it->second);
+  transactions_.erase(it);
+  if (!callback)
+    return;
+
+  // The system frees the data handle after the callback returns
+  DWORD size = 0;
+  const BYTE* bytes = hdata ? ::DdeAccessData(hdata, &size) : nullptr;
+  callback(hdata != 0, bytes, bytes ? size : 0);
+  if (bytes)
+    ::DdeUnaccessData(hdata);
+}
 
-  FreeStringHandle(hszItem);
+void DynamicDataExchange::FailTransactions(HCONV conversation) {
+  std::vector<TransactionCallback> callbacks;
 
-  if (output) {
-    char szResult[255];
-    ::DdeGetData(hData, (unsigned char*)szResult, 255, 0);
-    output->assign(StrToWstr(szResult));
+  for (auto it = transactions_.begin(); it != transactions_.end(); ) {
+    if (it->first.first == conversation) {
+      callbacks.push_back(std::move(it->second));
+      it = transactions_.erase(it);
+    } else {
+      ++it;
+    }
   }
 
-  return hData != 0;
+  for (auto& callback : callbacks)
+    if (callback)
+      callback(FALSE, nullptr, 0);
+}
+
+BOOL DynamicDataExchange::StartAdvise(HCONV conversation,
+                                      const std::wstring& item,
+                                      bool warm, DWORD timeout) {
+  UINT wType = XTYP_ADVSTART;
+  if (warm)
+    wType |= XTYPF_NODATA;
+  DWORD dwResult = 0;
+  return Transact(conversation, item, std::wstring(), wType, timeout,
+                  &dwResult) != 0;
+}
+
+BOOL DynamicDataExchange::StopAdvise(HCONV conversation,
+                                     const std::wstring& item,
+                                     DWORD timeout) {
+  DWORD dwResult = 0;
+  return Transact(conversation, item, std::wstring(), XTYP_ADVSTOP, timeout,
+                  &dwResult) != 0;
+}
+
+void DynamicDataExchange::EncodeText(const std::wstring& text,
+                                     std::string& output) const {
+  if (is_unicode_) {
+    auto bytes = reinterpret_cast<const char*>(text.c_str());
+    output.assign(bytes, (text.size() + 1) * sizeof(wchar_t));
+  } else {
+    output = WstrToStr(text);
+    output.push_back('\0');
+  }
+}
+
+UINT DynamicDataExchange::GetFormat() const {
+  return is_unicode_ ? CF_UNICODETEXT : CF_TEXT;
+}
+
+std::wstring DynamicDataExchange::DecodeText(const BYTE* data,
+                                             DWORD data_size) const {
+  if (!data || !data_size)
+    return std::wstring();
+
+  if (is_unicode_) {
+    auto text = reinterpret_cast<const wchar_t*>(data);
+    auto end = text + data_size / sizeof(wchar_t);
+    return std::wstring(text, std::find(text, end, L'\0'));
+  } else {
+    auto text = reinterpret_cast<const char*>(data);
+    auto end = text + data_size;
+    return StrToWstr(std::string(text, std::find(text, end, '\0')));
+  }
 }
 
 BOOL DynamicDataExchange::IsAvailable() {
@@ -121,25 +372,204 @@ BOOL DynamicDataExchange::IsAvailable() {
 }
 
 BOOL DynamicDataExchange::NameService(const std::wstring& service, UINT afCmd) {
-  HSZ hszService = CreateStringHandle(service);
+  HSZ hszService = GetStringHandle(service);
   HDDEDATA result = ::DdeNameService(instance_, hszService, 0, afCmd);
-  FreeStringHandle(hszService);
+
+  if (result) {
+    auto it = std::find(services_.begin(), services_.end(), hszService);
+    if (afCmd & DNS_UNREGISTER) {
+      if (it != services_.end())
+        services_.erase(it);
+    } else if (afCmd & DNS_REGISTER) {
+      if (it == services_.end())
+        services_.push_back(hszService);
+    }
+  }
+
   return result != nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-HSZ DynamicDataExchange::CreateStringHandle(const std::wstring& str) {
+bool DynamicDataExchange::StringHandleLess::operator()(HSZ a, HSZ b) const {
+  return ::DdeCmpStringHandles(a, b) < 0;
+}
+
+void DynamicDataExchange::RegisterTopic(const std::wstring& topic,
+                                        ItemProvider provider) {
+  auto& entry = topics_[GetStringHandle(topic)];
+  entry.name = topic;
+  entry.provider = provider;
+}
+
+void DynamicDataExchange::UnregisterTopic(const std::wstring& topic) {
+  auto it = topics_.find(GetStringHandle(topic));
+  if (it == topics_.end())
+    return;
+
+  for (const auto& item : it->second.items)
+    ::DdeFreeDataHandle(item.second);
+  topics_.erase(it);
+}
+
+BOOL DynamicDataExchange::SetItemData(const std::wstring& topic,
+                                      const std::wstring& item,
+                                      const std::wstring& data) {
+  if (!instance_)
+    return FALSE;
+
+  HSZ hszTopic = GetStringHandle(topic);
+  HSZ hszItem = GetStringHandle(item);
+
+  HDDEDATA hData = CreateItemData(hszItem, data);
+  if (!hData)
+    return FALSE;
+
+  auto& entry = topics_[hszTopic];
+  if (entry.name.empty())
+    entry.name = topic;
+  auto& handle = entry.items[hszItem];
+  if (handle)
+    ::DdeFreeDataHandle(handle);
+  handle = hData;
+
+  // Clients with an advise loop on the item are sent the new data handle
+  ::DdePostAdvise(instance_, hszTopic, hszItem);
+
+  return TRUE;
+}
+
+BOOL DynamicDataExchange::OnConnect(const std::wstring& topic,
+                                    const std::wstring& service) {
+  return topics_.empty() ||
+         topics_.find(GetStringHandle(topic)) != topics_.end();
+}
+
+BOOL DynamicDataExchange::OnRequest(const std::wstring& topic,
+                                    const std::wstring& item,
+                                    std::wstring& data) {
+  auto it = topics_.find(GetStringHandle(topic));
+  if (it == topics_.end() || !it->second.provider)
+    return FALSE;
+  return it->second.provider(item, data);
+}
+
+HDDEDATA DynamicDataExchange::GetItemData(HSZ topic, HSZ item, UINT format) {
+  if (format != GetFormat())
+    return nullptr;
+
+  auto topic_it = topics_.find(topic);
+  if (topic_it != topics_.end()) {
+    auto item_it = topic_it->second.items.find(item);
+    if (item_it != topic_it->second.items.end())
+      return item_it->second;
+  }
+
+  const std::wstring topic_name = QueryString(topic);
+  const std::wstring item_name = QueryString(item);
+
+  std::wstring data;
+  if (!OnRequest(topic_name, item_name, data))
+    return nullptr;
+
+  // Handles passed to the callback are only valid during the call
+  HSZ hszTopic = GetStringHandle(topic_name);
+  HSZ hszItem = GetStringHandle(item_name);
+
+  HDDEDATA hData = CreateItemData(hszItem, data);
+  if (hData) {
+    auto& entry = topics_[hszTopic];
+    if (entry.name.empty())
+      entry.name = topic_name;
+    entry.items[hszItem] = hData;
+  }
+  return hData;
+}
+
+HDDEDATA DynamicDataExchange::CreateItemData(HSZ item,
+                                             const std::wstring& data) {
+  std::string buffer;
+  EncodeText(data, buffer);
+  // Application-owned handles are not freed by the system when returned from
+  // the callback, so the same handle can answer any number of transactions.
+  return ::DdeCreateDataHandle(instance_, (LPBYTE)buffer.data(),
+                               static_cast<DWORD>(buffer.size()), 0, item,
+                               GetFormat(), HDATA_APPOWNED);
+}
+
+void DynamicDataExchange::FreeItemData() {
+  for (const auto& topic : topics_)
+    for (const auto& item : topic.second.items)
+      ::DdeFreeDataHandle(item.second);
+  topics_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+HSZ DynamicDataExchange::GetStringHandle(const std::wstring& str) {
+  if (!instance_)
+    return nullptr;
+
+  const int code_page = is_unicode_ ? CP_WINUNICODE : CP_WINANSI;
+  auto& hsz = string_handles_[std::make_pair(code_page, str)];
+
+  if (!hsz) {
+    if (is_unicode_) {
+      hsz = ::DdeCreateStringHandleW(instance_, str.c_str(), code_page);
+    } else {
+      hsz = ::DdeCreateStringHandleA(instance_, WstrToStr(str).c_str(),
+                                     code_page);
+    }
+  }
+
+  return hsz;
+}
+
+void DynamicDataExchange::FreeStringHandles() {
+  for (const auto& it : string_handles_)
+    if (it.second)
+      ::DdeFreeStringHandle(instance_, it.second);
+  string_handles_.clear();
+}
+
+std::wstring DynamicDataExchange::QueryString(HSZ str) const {
+  if (!str)
+    return std::wstring();
+
   if (is_unicode_) {
-    return ::DdeCreateStringHandleW(instance_, str.c_str(), CP_WINUNICODE);
+    DWORD length = ::DdeQueryStringW(instance_, str, nullptr, 0,
+                                     CP_WINUNICODE);
+    std::wstring output(length + 1, L'\0');
+    length = ::DdeQueryStringW(instance_, str, &output[0], length + 1,
+                               CP_WINUNICODE);
+    output.resize(length);
+    return output;
   } else {
-    return ::DdeCreateStringHandleA(instance_, WstrToStr(str).c_str(), CP_WINANSI);
+    DWORD length = ::DdeQueryStringA(instance_, str, nullptr, 0, CP_WINANSI);
+    std::string output(length + 1, '\0');
+    length = ::DdeQueryStringA(instance_, str, &output[0], length + 1,
+                               CP_WINANSI);
+    output.resize(length);
+    return StrToWstr(output);
   }
 }
 
-void DynamicDataExchange::FreeStringHandle(HSZ str) {
-  if (str)
-    ::DdeFreeStringHandle(instance_, str);
+DynamicDataExchange* DynamicDataExchange::FromService(HSZ service) {
+  Lock lock(dde_instances_section);
+
+  const DWORD thread_id = ::GetCurrentThreadId();
+
+  for (auto dde : dde_instances) {
+    if (dde->thread_id_ != thread_id || dde->services_.empty())
+      continue;
+    if (!service)
+      return dde;
+    for (auto registered : dde->services_)
+      if (::DdeCmpStringHandles(service, registered) == 0)
+        return dde;
+  }
+
+  return nullptr;
 }
 
 HDDEDATA CALLBACK DynamicDataExchange::DdeCallback(UINT uType, UINT uFmt,
@@ -147,50 +577,80 @@ HDDEDATA CALLBACK DynamicDataExchange::DdeCallback(UINT uType, UINT uFmt,
                                                    HSZ hsz1, HSZ hsz2,
                                                    HDDEDATA hdata,
                                                    DWORD dwData1, DWORD dwData2) {
-  DWORD cb = 0;
-  LPVOID lpData = nullptr;
-  char sz1[256] = {'\0'};
-  char sz2[256] = {'\0'};
-  //DdeQueryStringA(instance_, hsz1, sz1, 256, CP_WINANSI);
-  //DdeQueryStringA(instance_, hsz2, sz2, 256, CP_WINANSI);
-
   switch (uType) {
+    case XTYP_XACT_COMPLETE: {
+      auto dde = FromConversation(hconv);
+      if (dde)
+        dde->CompleteTransaction(hconv, dwData1, hdata);
+      break;
+    }
+
+    case XTYP_DISCONNECT: {
+      // The handle stays valid for DdeReconnect until we disconnect it
+      auto dde = FromConversation(hconv);
+      if (dde)
+        dde->FailTransactions(hconv);
+      break;
+    }
+
     case XTYP_CONNECT: {
-      OutputDebugStringA("[CONNECT]\n");
-      //BOOL result = OnConnect();
-      return reinterpret_cast<HDDEDATA>(TRUE);
+      auto dde = FromService(hsz2);
+      if (!dde)
+        return reinterpret_cast<HDDEDATA>(FALSE);
+      BOOL result = dde->OnConnect(dde->QueryString(hsz1),
+                                   dde->QueryString(hsz2));
+      return reinterpret_cast<HDDEDATA>(result);
     }
 
-    case XTYP_POKE: {
-      if (hdata)
-        lpData = DdeAccessData(hdata, &cb);
-#ifdef _DEBUG
-      std::string str = "[POKE]";
-      str += "Topic: " + *sz1;
-      str += " - Item: " + *sz2;
-      if (lpData) str += " - Data: "; str += (LPCSTR)lpData;
-      str += "\n";
-      OutputDebugStringA(str.c_str());
-#endif
-      //OnPoke();
-      if (hdata)
-        DdeUnaccessData(hdata);
-      return reinterpret_cast<HDDEDATA>(DDE_FACK);
+    case XTYP_CONNECT_CONFIRM: {
+      auto dde = FromService(hsz2);
+      if (dde)
+        ::DdeSetUserHandle(hconv, QID_SYNC, reinterpret_cast<DWORD_PTR>(dde));
+      break;
     }
 
-    case XTYP_REQUEST: {
-      // TODO: Call DdeCreateDataHandle();
-#ifdef _DEBUG
-      std::string str = "[REQUEST] ";
-      str += "Topic: "; str += sz1;
-      str += " - Item: "; str += sz2;
-      str += "\n";
-      OutputDebugStringA(str.c_str());
-#endif
-      //OnRequest();
+    case XTYP_REQUEST:
+    case XTYP_ADVREQ: {
+      auto dde = FromConversation(hconv);
+      if (dde)
+        return dde->GetItemData(hsz1, hsz2, uFmt);
       break;
     }
 
+    case XTYP_ADVSTART: {
+      auto dde = FromConversation(hconv);
+      BOOL result = dde && dde->GetItemData(hsz1, hsz2, uFmt) != nullptr;
+      return reinterpret_cast<HDDEDATA>(result);
+    }
+
+    case XTYP_POKE: {
+      auto dde = FromConversation(hconv);
+      if (!dde || uFmt != dde->GetFormat())
+        return reinterpret_cast<HDDEDATA>(DDE_FNOTPROCESSED);
+      DWORD size = 0;
+      const BYTE* bytes = hdata ? ::DdeAccessData(hdata, &size) : nullptr;
+      std::wstring data = dde->DecodeText(bytes, bytes ? size : 0);
+      if (bytes)
+        ::DdeUnaccessData(hdata);
+      BOOL result = dde->OnPoke(dde->QueryString(hsz1),
+                                dde->QueryString(hsz2), data);
+      return reinterpret_cast<HDDEDATA>(result ? DDE_FACK : DDE_FNOTPROCESSED);
+    }
+
+    case XTYP_ADVDATA: {
+      auto dde = FromConversation(hconv);
+      if (!dde)
+        return reinterpret_cast<HDDEDATA>(DDE_FNOTPROCESSED);
+      // Data is null for warm links
+      DWORD size = 0;
+      const BYTE* bytes = hdata ? ::DdeAccessData(hdata, &size) : nullptr;
+      dde->OnAdviseData(hconv, dde->QueryString(hsz1), dde->QueryString(hsz2),
+                        bytes, bytes ? size : 0);
+      if (bytes)
+        ::DdeUnaccessData(hdata);
+      return reinterpret_cast<HDDEDATA>(DDE_FACK);
+    }
+
     default:
       break;
   }
@@ -24,7 +24,11 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <windows.h>
 
@@ -34,6 +38,14 @@ namespace win {
 
 class DynamicDataExchange {
 public:
+  // Completion callbacks are called from the DDE callback on the thread that
+  // initialized the instance. Data is only valid during the call.
+  typedef std::function<void(BOOL success, const BYTE* data,
+                             DWORD data_size)> TransactionCallback;
+  // Fills the data of an item that has not been set with SetItemData yet.
+  typedef std::function<BOOL(const std::wstring& item,
+                             std::wstring& data)> ItemProvider;
+
   DynamicDataExchange();
   ~DynamicDataExchange();
 
@@ -47,23 +59,106 @@ public:
   BOOL ClientTransaction(const std::wstring& item,
                          const std::wstring& data,
                          std::wstring* output,
-                         UINT wType);
+                         UINT wType,
+                         DWORD timeout = 3000);
+  BOOL ClientTransaction(HCONV conversation,
+                         const std::wstring& item,
+                         const std::wstring& data,
+                         std::wstring* output,
+                         UINT wType,
+                         DWORD timeout = 3000);
+  BOOL ClientTransactionAsync(const std::wstring& item,
+                              const std::wstring& data,
+                              UINT wType,
+                              TransactionCallback callback);
+  BOOL ClientTransactionAsync(HCONV conversation,
+                              const std::wstring& item,
+                              const std::wstring& data,
+                              UINT wType,
+                              TransactionCallback callback);
+  void AbandonTransactions(HCONV conversation = nullptr);
+
+  // Returns a pooled conversation, reconnecting if the server has terminated
+  // it. Pooled conversations are owned by the instance.
+  HCONV GetConversation(const std::wstring& service, const std::wstring& topic);
+  void DisconnectAll();
+
+  BOOL StartAdvise(HCONV conversation, const std::wstring& item,
+                   bool warm = false, DWORD timeout = 3000);
+  BOOL StopAdvise(HCONV conversation, const std::wstring& item,
+                  DWORD timeout = 3000);
+
+  std::wstring DecodeText(const BYTE* data, DWORD data_size) const;
+
   BOOL IsAvailable();
   BOOL NameService(const std::wstring& service, UINT afCmd = DNS_REGISTER);
 
-  virtual BOOL OnConnect() { return TRUE; }
-  virtual void OnPoke() {}
-  virtual void OnRequest() {}
+  // Server items are cached as application-owned data handles, which are
+  // reused for every request and advise loop until the data changes.
+  void RegisterTopic(const std::wstring& topic, ItemProvider provider = nullptr);
+  void UnregisterTopic(const std::wstring& topic);
+  BOOL SetItemData(const std::wstring& topic, const std::wstring& item,
+                   const std::wstring& data);
+
+  virtual BOOL OnConnect(const std::wstring& topic,
+                         const std::wstring& service);
+  virtual BOOL OnPoke(const std::wstring& topic, const std::wstring& item,
+                      const std::wstring& data) { return FALSE; }
+  virtual BOOL OnRequest(const std::wstring& topic, const std::wstring& item,
+                         std::wstring& data);
+  virtual void OnAdviseData(HCONV conversation, const std::wstring& topic,
+                            const std::wstring& item,
+                            const BYTE* data, DWORD data_size) {}
 
 private:
-  HSZ CreateStringHandle(const std::wstring& str);
-  void FreeStringHandle(HSZ str);
-
+  // Orders string handles the way DDEML compares them, so that handles
+  // received in the callback can be looked up without querying the string.
+  struct StringHandleLess {
+    bool operator()(HSZ a, HSZ b) const;
+  };
+  struct Topic {
+    std::wstring name;
+    ItemProvider provider;
+    std::map<HSZ, HDDEDATA, StringHandleLess> items;
+  };
+
+  typedef std::pair<HCONV, DWORD> TransactionId;
+  typedef std::pair<std::wstring, std::wstring> ConversationKey;
+  typedef std::pair<int, std::wstring> StringHandleKey;
+
+  void EncodeText(const std::wstring& text, std::string& output) const;
+  UINT GetFormat() const;
+  std::wstring QueryString(HSZ str) const;
+
+  HDDEDATA GetItemData(HSZ topic, HSZ item, UINT format);
+  HDDEDATA CreateItemData(HSZ item, const std::wstring& data);
+  void FreeItemData();
+
+  HCONV ConnectConversation(const std::wstring& service,
+                            const std::wstring& topic);
+  HDDEDATA Transact(HCONV conversation, const std::wstring& item,
+                    const std::wstring& data, UINT wType, DWORD timeout,
+                    LPDWORD result);
+  void CompleteTransaction(HCONV conversation, DWORD id, HDDEDATA hdata);
+  void FailTransactions(HCONV conversation);
+
+  HSZ GetStringHandle(const std::wstring& str);
+  void FreeStringHandles();
+
+  static DynamicDataExchange* FromConversation(HCONV conversation);
+  static DynamicDataExchange* FromService(HSZ service);
+  static bool IsConnected(HCONV conversation);
   static FNCALLBACK DdeCallback;
 
   HCONV conversation_;
+  std::map<ConversationKey, HCONV> conversations_;
+  std::map<TransactionId, TransactionCallback> transactions_;
+  std::map<StringHandleKey, HSZ> string_handles_;
+  std::map<HSZ, Topic, StringHandleLess> topics_;
+  std::vector<HSZ> services_;
   DWORD instance_;
   bool is_unicode_;
+  DWORD thread_id_;
 };
 
 }  // namespace win
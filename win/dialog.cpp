@@ -27,6 +27,7 @@ SOFTWARE.
 #include <windowsx.h>
 
 #include "dialog.h"
+#include "retained_paint.h"
 #include "taskbar.h"
 #include "window_map.h"
 
@@ -277,6 +278,7 @@ INT_PTR Dialog::DialogProcDefault(HWND hwnd, UINT uMsg,
       break;
     }
     case WM_DESTROY: {
+      GetRetainedPaintCache().Remove(hwnd);
       OnDestroy();
       break;
     }
@@ -330,27 +332,38 @@ INT_PTR Dialog::DialogProcDefault(HWND hwnd, UINT uMsg,
       break;
     }
     case WM_NOTIFY: {
-      LRESULT result = OnNotify(wParam, reinterpret_cast<LPNMHDR>(lParam));
+      LRESULT result = 0;
+      if (ReflectNotify(reinterpret_cast<LPNMHDR>(lParam), result)) {
+        ::SetWindowLongPtr(hwnd, DWLP_MSGRESULT, result);
+        return TRUE;
+      }
+      result = OnNotify(wParam, reinterpret_cast<LPNMHDR>(lParam));
       if (result) {
         ::SetWindowLongPtr(hwnd, DWLP_MSGRESULT, result);
         return TRUE;
       }
       break;
     }
-    case WM_PAINT: {
-      if (::GetUpdateRect(hwnd, nullptr, FALSE)) {
-        PAINTSTRUCT ps;
-        HDC hdc = ::BeginPaint(hwnd, &ps);
-        OnPaint(hdc, &ps);
-        ::EndPaint(hwnd, &ps);
-      } else {
-        HDC hdc = ::GetDC(hwnd);
-        OnPaint(hdc, nullptr);
-        ::ReleaseDC(hwnd, hdc);
+    case WM_ERASEBKGND: {
+      if (buffered_paint_) {
+        ::SetWindowLongPtr(hwnd, DWLP_MSGRESULT, TRUE);
+        return TRUE;
       }
       break;
     }
+    case WM_PAINT: {
+      PaintWindow(hwnd);
+      break;
+    }
+    case WM_SHOWWINDOW: {
+      // Hidden dialogs give up their retained content
+      if (!wParam)
+        GetRetainedPaintCache().Remove(hwnd);
+      break;
+    }
     case WM_SIZE: {
+      if (wParam == SIZE_MINIMIZED)
+        GetRetainedPaintCache().Remove(hwnd);
       SIZE size = {LOWORD(lParam), HIWORD(lParam)};
       OnSize(uMsg, static_cast<UINT>(wParam), size);
       break;
@@ -26,28 +26,38 @@ SOFTWARE.
 
 namespace win {
 
+// Font handles are reused after deletion, so the text caches must forget them
+void DestroyFont(HFONT font) {
+  RemoveFontFromTextCaches(font);
+  ::DeleteObject(font);
+}
+
 Dc::Dc()
     : dc_(nullptr),
       bitmap_old_(nullptr),
       brush_old_(nullptr),
-      font_old_(nullptr) {
+      brush_cached_(false),
+      font_old_(nullptr),
+      pen_old_(nullptr) {
 }
 
 Dc::Dc(HDC hdc)
     : dc_(hdc),
       bitmap_old_(nullptr),
       brush_old_(nullptr),
-      font_old_(nullptr) {
+      brush_cached_(false),
+      font_old_(nullptr),
+      pen_old_(nullptr) {
 }
 
 Dc::~Dc() {
   if (dc_) {
     if (bitmap_old_)
       ::DeleteObject(::SelectObject(dc_, bitmap_old_));
-    if (brush_old_)
-      ::DeleteObject(::SelectObject(dc_, brush_old_));
+    RestoreBrush();
+    RestorePen();
     if (font_old_)
-      ::DeleteObject(::SelectObject(dc_, font_old_));
+      DestroyFont(reinterpret_cast<HFONT>(::SelectObject(dc_, font_old_)));
 
     HWND hwnd = ::WindowFromDC(dc_);
     if (hwnd) {
@@ -75,10 +85,10 @@ HDC Dc::DetachDc() {
 
   if (bitmap_old_)
     ::DeleteObject(::SelectObject(dc_, bitmap_old_));
-  if (brush_old_)
-    ::DeleteObject(::SelectObject(dc_, brush_old_));
+  RestoreBrush();
+  RestorePen();
   if (font_old_)
-    ::DeleteObject(::SelectObject(dc_, font_old_));
+    DestroyFont(reinterpret_cast<HFONT>(::SelectObject(dc_, font_old_)));
 
   HDC hdc = dc_;
   dc_ = nullptr;
@@ -94,8 +104,7 @@ void Dc::AttachBrush(HBRUSH brush) {
   if (!dc_ || !brush)
     return;
 
-  if (brush_old_)
-    ::DeleteObject(::SelectObject(dc_, brush_old_));
+  RestoreBrush();
 
   brush_old_ = reinterpret_cast<HBRUSH>(::SelectObject(dc_, brush));
 }
@@ -104,29 +113,94 @@ void Dc::CreateSolidBrush(COLORREF color) {
   if (!dc_)
     return;
 
-  if (brush_old_)
-    ::DeleteObject(::SelectObject(dc_, brush_old_));
+  RestoreBrush();
 
-  HBRUSH brush = ::CreateSolidBrush(color);
+  HBRUSH brush = GetGdiObjectCache().GetSolidBrush(color);
   brush_old_ = reinterpret_cast<HBRUSH>(::SelectObject(dc_, brush));
+  brush_cached_ = true;
 }
 
 HBRUSH Dc::DetachBrush() {
   if (!dc_ || !brush_old_)
     return nullptr;
 
+  // Cached brushes are shared, so the caller gets a brush of its own
+  if (brush_cached_) {
+    HGDIOBJ brush = ::GetCurrentObject(dc_, OBJ_BRUSH);
+    COLORREF color = ::GetDCBrushColor(dc_);
+    if (brush != ::GetStockObject(DC_BRUSH)) {
+      LOGBRUSH logbrush = {0};
+      ::GetObject(brush, sizeof(logbrush), &logbrush);
+      color = logbrush.lbColor;
+    }
+    RestoreBrush();
+    return ::CreateSolidBrush(color);
+  }
+
   HBRUSH brush = reinterpret_cast<HBRUSH>(::SelectObject(dc_, brush_old_));
   brush_old_ = nullptr;
 
   return brush;
 }
 
+void Dc::SelectDcBrush(COLORREF color) {
+  if (!dc_)
+    return;
+
+  RestoreBrush();
+
+  brush_old_ = reinterpret_cast<HBRUSH>(
+      ::SelectObject(dc_, ::GetStockObject(DC_BRUSH)));
+  brush_cached_ = true;
+  ::SetDCBrushColor(dc_, color);
+}
+
+void Dc::RestoreBrush() {
+  if (!brush_old_)
+    return;
+
+  HGDIOBJ brush = ::SelectObject(dc_, brush_old_);
+  if (!brush_cached_)
+    ::DeleteObject(brush);
+
+  brush_old_ = nullptr;
+  brush_cached_ = false;
+}
+
+void Dc::SelectDcPen(COLORREF color) {
+  if (!dc_)
+    return;
+
+  HGDIOBJ pen = ::SelectObject(dc_, ::GetStockObject(DC_PEN));
+  if (!pen_old_)
+    pen_old_ = reinterpret_cast<HPEN>(pen);
+  ::SetDCPenColor(dc_, color);
+}
+
+void Dc::SelectPen(COLORREF color, int width, int style) {
+  if (!dc_)
+    return;
+
+  HPEN pen = GetGdiObjectCache().GetPen(color, width, style);
+  HGDIOBJ pen_old = ::SelectObject(dc_, pen);
+  if (!pen_old_)
+    pen_old_ = reinterpret_cast<HPEN>(pen_old);
+}
+
+void Dc::RestorePen() {
+  if (!pen_old_)
+    return;
+
+  ::SelectObject(dc_, pen_old_);
+  pen_old_ = nullptr;
+}
+
 void Dc::AttachFont(HFONT font) {
   if (!dc_ || !font)
     return;
 
   if (font_old_)
-    ::DeleteObject(::SelectObject(dc_, font_old_));
+    DestroyFont(reinterpret_cast<HFONT>(::SelectObject(dc_, font_old_)));
 
   font_old_ = reinterpret_cast<HFONT>(::SelectObject(dc_, font));
 }
@@ -144,7 +218,7 @@ HFONT Dc::DetachFont() {
 void Dc::EditFont(LPCWSTR face_name, INT size,
                   BOOL bold, BOOL italic, BOOL underline) {
   if (font_old_)
-    ::DeleteObject(::SelectObject(dc_, font_old_));
+    DestroyFont(reinterpret_cast<HFONT>(::SelectObject(dc_, font_old_)));
   font_old_ = reinterpret_cast<HFONT>(::GetCurrentObject(dc_, OBJ_FONT));
 
   LOGFONT logfont;
@@ -172,9 +246,25 @@ BOOL Dc::FillRect(const RECT& rect, HBRUSH brush) const {
 }
 
 void Dc::FillRect(const RECT& rect, COLORREF color) const {
-  COLORREF old_color = ::SetBkColor(dc_, color);
-  ::ExtTextOut(dc_, 0, 0, ETO_OPAQUE, &rect, L"", 0, nullptr);
-  ::SetBkColor(dc_, old_color);
+  ::FillRect(dc_, &rect, GetGdiObjectCache().GetSolidBrush(color));
+}
+
+// Uses the DC brush, which is better suited to colors that are only used once
+BOOL Dc::FillDcRect(const RECT& rect, COLORREF color) const {
+  HBRUSH brush = reinterpret_cast<HBRUSH>(::GetStockObject(DC_BRUSH));
+  COLORREF old_color = ::SetDCBrushColor(dc_, color);
+  BOOL result = ::FillRect(dc_, &rect, brush);
+  ::SetDCBrushColor(dc_, old_color);
+  return result;
+}
+
+BOOL Dc::FrameRect(const RECT& rect, COLORREF color) const {
+  return ::FrameRect(dc_, &rect, GetGdiObjectCache().GetSolidBrush(color));
+}
+
+BOOL Dc::DrawLine(int x1, int y1, int x2, int y2) const {
+  POINT points[] = {{x1, y1}, {x2, y2}};
+  return ::Polyline(dc_, points, 2);
 }
 
 void Dc::AttachBitmap(HBITMAP bitmap) {
@@ -213,6 +303,11 @@ BOOL Dc::StretchBlt(int x, int y, int width, int height,
                       dc_src, x_src, y_src, width_src, height_src, rop);
 }
 
+BOOL Dc::DrawGlyphs(int x, int y, const std::wstring& text, UINT options,
+                    LPCRECT rect) const {
+  return GetGlyphRunCache().Draw(dc_, x, y, text, options, rect);
+}
+
 int Dc::DrawText(LPCWSTR text, int count, const RECT& rect, UINT format) const {
   return ::DrawText(dc_, text, count, const_cast<LPRECT>(&rect), format);
 }
@@ -221,6 +316,11 @@ COLORREF Dc::GetTextColor() const {
   return ::GetTextColor(dc_);
 }
 
+const TextLayout& Dc::MeasureText(const std::wstring& text, int width,
+                                  UINT format) const {
+  return GetTextLayoutCache().Measure(dc_, text, width, format);
+}
+
 COLORREF Dc::SetBkColor(COLORREF color) const {
   return ::SetBkColor(dc_, color);
 }
@@ -235,6 +335,77 @@ COLORREF Dc::SetTextColor(COLORREF color) const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+GdiObjectCache::GdiObjectCache(size_t capacity)
+    : brushes_(capacity, [this](const COLORREF&, HBRUSH& brush) {
+        DeleteObject(brush);
+      }),
+      pens_(capacity, [this](const PenKey&, HPEN& pen) {
+        DeleteObject(pen);
+      }) {
+}
+
+GdiObjectCache::~GdiObjectCache() {
+  Clear();
+}
+
+HBRUSH GdiObjectCache::GetSolidBrush(COLORREF color) {
+  HBRUSH* brush = brushes_.Get(color);
+  if (brush)
+    return *brush;
+
+  DeleteZombies();
+
+  HBRUSH new_brush = ::CreateSolidBrush(color);
+  if (!new_brush)
+    return nullptr;
+  return brushes_.Put(color, new_brush);
+}
+
+HPEN GdiObjectCache::GetPen(COLORREF color, int width, int style) {
+  const PenKey key(color, width, style);
+
+  HPEN* pen = pens_.Get(key);
+  if (pen)
+    return *pen;
+
+  DeleteZombies();
+
+  HPEN new_pen = ::CreatePen(style, width, color);
+  if (!new_pen)
+    return nullptr;
+  return pens_.Put(key, new_pen);
+}
+
+void GdiObjectCache::Clear() {
+  brushes_.Clear();
+  pens_.Clear();
+  DeleteZombies();
+}
+
+void GdiObjectCache::DeleteObject(HGDIOBJ object) {
+  // Fails if the object is still selected into a DC
+  if (!::DeleteObject(object))
+    zombies_.push_back(object);
+}
+
+void GdiObjectCache::DeleteZombies() {
+  auto it = zombies_.begin();
+  while (it != zombies_.end()) {
+    if (::DeleteObject(*it)) {
+      it = zombies_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+GdiObjectCache& GetGdiObjectCache() {
+  thread_local GdiObjectCache gdi_object_cache;
+  return gdi_object_cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Brush::Brush()
     : brush_(nullptr) {
 }
@@ -280,8 +451,10 @@ HFONT Font::Get() const {
 }
 
 void Font::Set(HFONT font) {
-  if (font_)
+  if (font_) {
+    RemoveFontFromTextCaches(font_);
     ::DeleteObject(font_);
+  }
   font_ = font;
 }
 
@@ -291,84 +464,92 @@ Font::operator HFONT() const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Rect::Rect() {
-  left = 0; top = 0; right = 0; bottom = 0;
-}
-
-Rect::Rect(int l, int t, int r, int b) {
-  left = l; top = t; right = r; bottom = b;
-}
-
-Rect::Rect(const RECT& rect) {
-  ::CopyRect(this, &rect);
-}
-
-Rect::Rect(LPCRECT rect) {
-  ::CopyRect(this, rect);
-}
-
-BOOL Rect::operator==(const RECT& rect) const {
-  return ::EqualRect(this, &rect);
+BackBuffer::BackBuffer()
+    : dc_(nullptr),
+      bitmap_(nullptr),
+      bitmap_old_(nullptr),
+      target_(nullptr),
+      saved_state_(0) {
+  size_.cx = 0;
+  size_.cy = 0;
+  ::SetRectEmpty(&rect_);
 }
 
-BOOL Rect::operator!=(const RECT& rect) const {
-  return !::EqualRect(this, &rect);
+BackBuffer::~BackBuffer() {
+  Release();
 }
 
-void Rect::operator=(const RECT& rect) {
-  ::CopyRect(this, &rect);
-}
+HDC BackBuffer::Begin(HDC hdc, const RECT& rect) {
+  const int width = rect.right - rect.left;
+  const int height = rect.bottom - rect.top;
+  if (!hdc || width <= 0 || height <= 0)
+    return nullptr;
 
-int Rect::Height() const {
-  return bottom - top;
-}
+  if (!dc_) {
+    dc_ = ::CreateCompatibleDC(hdc);
+    if (!dc_)
+      return nullptr;
+  }
 
-int Rect::Width() const {
-  return right - left;
-}
+  if (!bitmap_ || width > size_.cx || height > size_.cy) {
+    SIZE size = {width > size_.cx ? width : size_.cx,
+                 height > size_.cy ? height : size_.cy};
+    HBITMAP bitmap = ::CreateCompatibleBitmap(hdc, size.cx, size.cy);
+    if (!bitmap)
+      return nullptr;
+    if (bitmap_) {
+      ::SelectObject(dc_, bitmap_old_);
+      ::DeleteObject(bitmap_);
+    }
+    bitmap_old_ = reinterpret_cast<HBITMAP>(::SelectObject(dc_, bitmap));
+    bitmap_ = bitmap;
+    size_ = size;
+  }
 
-void Rect::Copy(const RECT& rect) {
-  ::CopyRect(this, &rect);
-}
+  // Anything selected or changed while painting is undone in End()
+  saved_state_ = ::SaveDC(dc_);
+  ::SetWindowOrgEx(dc_, rect.left, rect.top, nullptr);
+  ::IntersectClipRect(dc_, rect.left, rect.top, rect.right, rect.bottom);
 
-BOOL Rect::Equal(const RECT& rect) const {
-  return ::EqualRect(&rect, this);
-}
+  target_ = hdc;
+  rect_ = rect;
 
-BOOL Rect::Inflate(int dx, int dy) {
-  return ::InflateRect(this, dx, dy);
-}
-
-BOOL Rect::Intersect(const RECT& rect1, const RECT& rect2) {
-  return ::IntersectRect(this, &rect1, &rect2);
+  return dc_;
 }
 
-BOOL Rect::IsEmpty() const {
-  return ::IsRectEmpty(this);
-}
+BOOL BackBuffer::End() {
+  if (!target_)
+    return FALSE;
 
-BOOL Rect::Offset(int dx, int dy) {
-  return ::OffsetRect(this, dx, dy);
-}
+  BOOL result = ::BitBlt(target_, rect_.left, rect_.top,
+                         rect_.right - rect_.left, rect_.bottom - rect_.top,
+                         dc_, rect_.left, rect_.top, SRCCOPY);
 
-BOOL Rect::PtIn(POINT point) const {
-  return ::PtInRect(this, point);
-}
+  ::RestoreDC(dc_, saved_state_);
+  saved_state_ = 0;
+  target_ = nullptr;
 
-BOOL Rect::Set(int left, int top, int right, int bottom) {
-  return ::SetRect(this, left, top, right, bottom);
+  return result;
 }
 
-BOOL Rect::SetEmpty() {
-  return ::SetRectEmpty(this);
-}
+void BackBuffer::Release() {
+  if (target_)
+    End();
 
-BOOL Rect::Subtract(const RECT& rect1, const RECT& rect2) {
-  return ::SubtractRect(this, &rect1, &rect2);
-}
+  if (dc_) {
+    if (bitmap_)
+      ::SelectObject(dc_, bitmap_old_);
+    ::DeleteDC(dc_);
+    dc_ = nullptr;
+  }
+  if (bitmap_) {
+    ::DeleteObject(bitmap_);
+    bitmap_ = nullptr;
+  }
 
-BOOL Rect::Union(const RECT& rect1, const RECT& rect2) {
-  return ::UnionRect(this, &rect1, &rect2);
+  bitmap_old_ = nullptr;
+  size_.cx = 0;
+  size_.cy = 0;
 }
 
 }  // namespace win
\ No newline at end of file
@@ -24,8 +24,16 @@ SOFTWARE.
 
 #pragma once
 
+#include <string>
+#include <tuple>
+#include <vector>
+
 #include <windows.h>
 
+#include "geometry.h"
+#include "lru_cache.h"
+#include "text_layout.h"
+
 namespace win {
 
 class Dc {
@@ -40,10 +48,16 @@ public:
   HDC  DetachDc();
   HDC  Get() const;
 
-  // Brush
+  // Brush. Solid brushes are shared through a per-thread cache. Detaching
+  // one returns a new brush of the same color, which the caller owns.
   void   AttachBrush(HBRUSH brush);
   void   CreateSolidBrush(COLORREF color);
   HBRUSH DetachBrush();
+  void   SelectDcBrush(COLORREF color);
+
+  // Pen (cached and stock pens are never deleted)
+  void SelectDcPen(COLORREF color);
+  void SelectPen(COLORREF color, int width = 1, int style = PS_SOLID);
 
   // Font
   void  AttachFont(HFONT font);
@@ -51,8 +65,11 @@ public:
   void  EditFont(LPCWSTR face_name = nullptr, INT size = -1, BOOL bold = -1, BOOL italic = -1, BOOL underline = -1);
 
   // Painting
+  BOOL DrawLine(int x1, int y1, int x2, int y2) const;
   BOOL FillRect(const RECT& rect, HBRUSH brush) const;
   void FillRect(const RECT& rect, COLORREF color) const;
+  BOOL FillDcRect(const RECT& rect, COLORREF color) const;
+  BOOL FrameRect(const RECT& rect, COLORREF color) const;
 
   // Bitmap
   void    AttachBitmap(HBITMAP bitmap);
@@ -62,19 +79,54 @@ public:
   BOOL    StretchBlt(int x, int y, int width, int height, HDC dc_src, int x_src, int y_src, int width_src, int height_src, DWORD rop) const;
 
   // Text
+  BOOL     DrawGlyphs(int x, int y, const std::wstring& text, UINT options = 0, LPCRECT rect = nullptr) const;
   int      DrawText(LPCWSTR text, int count, const RECT& rect, UINT format) const;
   COLORREF GetTextColor() const;
+  const TextLayout& MeasureText(const std::wstring& text, int width, UINT format) const;
   COLORREF SetBkColor(COLORREF color) const;
   int      SetBkMode(int bk_mode) const;
   COLORREF SetTextColor(COLORREF color) const;
 
 private:
+  void RestoreBrush();
+  void RestorePen();
+
   HDC     dc_;
   HBITMAP bitmap_old_;
   HBRUSH  brush_old_;
+  bool    brush_cached_;
   HFONT   font_old_;
+  HPEN    pen_old_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Solid brushes and pens that are shared by paint code on the same thread.
+// Objects are owned by the cache and must not be kept after painting. An
+// evicted object that is still selected into a DC is deleted later.
+
+class GdiObjectCache {
+public:
+  GdiObjectCache(size_t capacity = 64);
+  ~GdiObjectCache();
+
+  HBRUSH GetSolidBrush(COLORREF color);
+  HPEN   GetPen(COLORREF color, int width = 1, int style = PS_SOLID);
+  void   Clear();
+
+private:
+  typedef std::tuple<COLORREF, int, int> PenKey;
+
+  void DeleteObject(HGDIOBJ object);
+  void DeleteZombies();
+
+  LruCache<COLORREF, HBRUSH> brushes_;
+  LruCache<PenKey, HPEN> pens_;
+  std::vector<HGDIOBJ> zombies_;
 };
 
+GdiObjectCache& GetGdiObjectCache();
+
 ////////////////////////////////////////////////////////////////////////////////
 
 class Brush {
@@ -111,31 +163,28 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
-class Rect : public RECT {
+// An off-screen bitmap for flicker-free painting. The bitmap is kept between
+// paints and is only reallocated when a larger area is requested.
+
+class BackBuffer {
 public:
-  Rect();
-  Rect(int l, int t, int r, int b);
-  Rect(const RECT& rect);
-  Rect(LPCRECT rect);
-
-  BOOL operator==(const RECT& rect) const;
-  BOOL operator!=(const RECT& rect) const;
-  void operator=(const RECT& rect);
-
-  int Height() const;
-  int Width() const;
-
-  void Copy(const RECT& rect);
-  BOOL Equal(const RECT& rect) const;
-  BOOL Inflate(int dx, int dy);
-  BOOL Intersect(const RECT& rect1, const RECT& rect2);
-  BOOL IsEmpty() const;
-  BOOL Offset(int dx, int dy);
-  BOOL PtIn(POINT point) const;
-  BOOL Set(int left, int top, int right, int bottom);
-  BOOL SetEmpty();
-  BOOL Subtract(const RECT& rect1, const RECT& rect2);
-  BOOL Union(const RECT& rect1, const RECT& rect2);
+  BackBuffer();
+  ~BackBuffer();
+
+  // Returns a memory DC that uses the same coordinates as the target DC and is
+  // clipped to the given rectangle.
+  HDC  Begin(HDC hdc, const RECT& rect);
+  BOOL End();
+  void Release();
+
+private:
+  HDC     dc_;
+  HBITMAP bitmap_;
+  HBITMAP bitmap_old_;
+  SIZE    size_;
+  HDC     target_;
+  RECT    rect_;
+  int     saved_state_;
 };
 
 }  // namespace win
@@ -25,11 +25,79 @@ SOFTWARE.
 #pragma comment(lib, "gdiplus.lib")
 
 #include <memory>
+#include <vector>
 
 #include "gdi_plus.h"
+#include "icon_cache.h"
+#include "raster.h"
+#include "resample.h"
+#include "surface.h"
+#include "wic.h"
 
 namespace win {
 
+// Locks the bitmap bits once, in the format that needs no conversion by
+// GDI+ for bitmaps with alpha, and converts them into the surface.
+bool CopyBitmapPixels(Gdiplus::Bitmap& bitmap, Surface& surface,
+                      bool premultiplied) {
+  const UINT width = bitmap.GetWidth();
+  const UINT height = bitmap.GetHeight();
+  if (!surface.Create(width, height))
+    return false;
+
+  const bool source_premultiplied =
+      bitmap.GetPixelFormat() == PixelFormat32bppPARGB;
+
+  Gdiplus::Rect rect(0, 0, width, height);
+  Gdiplus::BitmapData data;
+  if (bitmap.LockBits(&rect, Gdiplus::ImageLockModeRead,
+                      source_premultiplied ? PixelFormat32bppPARGB :
+                                             PixelFormat32bppARGB,
+                      &data) != Gdiplus::Ok)
+    return false;
+
+  const auto src = static_cast<const uint32_t*>(data.Scan0);
+  uint32_t* dst = surface.GetPixels();
+  const int stride = surface.GetStride();
+
+  if (premultiplied == source_premultiplied) {
+    CopyPixels(dst, stride, src, data.Stride, width, height);
+  } else if (premultiplied) {
+    PremultiplyPixels(dst, stride, src, data.Stride, width, height);
+  } else {
+    UnpremultiplyPixels(dst, stride, src, data.Stride, width, height);
+  }
+
+  bitmap.UnlockBits(&data);
+  return true;
+}
+
+// Decodes an icon at its original size. Icons use straight alpha. The mask is
+// ignored for 32-bit color bitmaps with alpha, but must still be given.
+HICON DecodeIcon(const std::wstring& file, int, int) {
+  std::unique_ptr<Gdiplus::Bitmap> bitmap(
+      Gdiplus::Bitmap::FromFile(file.c_str()));
+
+  Surface surface;
+  if (!bitmap || !CopyBitmapPixels(*bitmap, surface, false))
+    return nullptr;
+
+  const SIZE size = surface.GetSize();
+  std::vector<BYTE> mask_bits(((size.cx + 15) / 16) * 2 * size.cy);
+  HBITMAP mask = ::CreateBitmap(size.cx, size.cy, 1, 1, mask_bits.data());
+  HBITMAP color = surface.DetachBitmap();
+
+  ICONINFO info = {TRUE, 0, 0, mask, color};
+  HICON icon_handle = ::CreateIconIndirect(&info);
+
+  ::DeleteObject(color);
+  ::DeleteObject(mask);
+
+  return icon_handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 GdiPlus::GdiPlus()
     : token_(0) {
   Gdiplus::GdiplusStartupInput input;
@@ -50,45 +118,44 @@ void GdiPlus::DrawRectangle(const HDC hdc, const RECT& rect,
 }
 
 HICON GdiPlus::LoadIcon(const std::wstring& file) {
-  HICON icon_handle = nullptr;
-
-  std::unique_ptr<Gdiplus::Bitmap> bitmap(
-      Gdiplus::Bitmap::FromFile(file.c_str()));
-
-  if (bitmap)
-    bitmap->GetHICON(&icon_handle);
+  return DecodeIcon(file, 0, 0);
+}
 
-  return icon_handle;
+HICON GdiPlus::LoadSharedIcon(const std::wstring& file) {
+  return GetIconCache().LoadFile(file, 0, 0, L"GdiPlus", DecodeIcon);
 }
 
+// Returns a premultiplied 32-bit DIB section, which can be used with
+// AlphaBlend and image lists. WIC is preferred, as it can scale the image
+// while decoding.
 HBITMAP GdiPlus::LoadImage(const std::wstring& file, UINT width, UINT height) {
-  HBITMAP bitmap_handle = nullptr;
+  Surface surface;
+  if (DecodeImage(file, width, height, surface))
+    return surface.DetachBitmap();
 
   std::unique_ptr<Gdiplus::Bitmap> bitmap(
       Gdiplus::Bitmap::FromFile(file.c_str()));
 
-  if (bitmap) {
-    const Gdiplus::Color color(Gdiplus::Color::AlphaMask);
-
-    if ((width > 0 && width != bitmap->GetWidth()) ||
-        (height > 0 && height != bitmap->GetHeight())) {
-      std::unique_ptr<Gdiplus::Bitmap> resized_bitmap(
-          new Gdiplus::Bitmap(width, height));
-
-      Gdiplus::Graphics graphics(resized_bitmap.get());
-      graphics.ScaleTransform(
-          width / static_cast<Gdiplus::REAL>(bitmap->GetWidth()),
-          height / static_cast<Gdiplus::REAL>(bitmap->GetHeight()));
-      graphics.DrawImage(bitmap.get(), 0, 0);
-
-      resized_bitmap->GetHBITMAP(color, &bitmap_handle);
-
-    } else {
-      bitmap->GetHBITMAP(color, &bitmap_handle);
-    }
-  }
-
-  return bitmap_handle;
+  if (!bitmap || !CopyBitmapPixels(*bitmap, surface, true))
+    return nullptr;
+
+  const SIZE size = surface.GetSize();
+  if (width == 0)
+    width = size.cx;
+  if (height == 0)
+    height = size.cy;
+  if (width == static_cast<UINT>(size.cx) &&
+      height == static_cast<UINT>(size.cy))
+    return surface.DetachBitmap();
+
+  Surface resized;
+  if (!resized.Create(width, height) ||
+      !ResamplePixels(resized.GetPixels(), resized.GetStride(),
+                      width, height, surface.GetPixels(), surface.GetStride(),
+                      size.cx, size.cy))
+    return nullptr;
+
+  return resized.DetachBitmap();
 }
 
 }  // namespace win
\ No newline at end of file
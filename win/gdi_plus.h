@@ -45,7 +45,13 @@ public:
   ~GdiPlus();
 
   void DrawRectangle(const HDC hdc, const RECT& rect, DWORD color);
+  // The caller owns the icon, and destroys it with DestroyIcon.
   HICON LoadIcon(const std::wstring& file);
+  // The icon is shared through the icon cache, so the file is only decoded
+  // once. It must be released with ReleaseIcon.
+  HICON LoadSharedIcon(const std::wstring& file);
+  // WIC is only used if COM is initialized on the calling thread. Otherwise
+  // the image is decoded by GDI+, without scaling while decoding.
   HBITMAP LoadImage(const std::wstring& file, UINT width, UINT height);
 
 private:
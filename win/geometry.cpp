@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <climits>
+
+#include "geometry.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIN_GEOMETRY_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace win {
+
+#ifdef WIN_GEOMETRY_SSE2
+
+// SSE2 has no 32-bit integer min/max, so they are built from comparisons
+inline __m128i Max32(__m128i a, __m128i b) {
+  const __m128i mask = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i Min32(__m128i a, __m128i b) {
+  const __m128i mask = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
+// Lanes are (left, top, right, bottom). Compares right > left and
+// bottom > top in the low lanes.
+inline bool IsEmptyRect(__m128i rect) {
+  const __m128i swapped = _mm_shuffle_epi32(rect, _MM_SHUFFLE(1, 0, 3, 2));
+  const int mask = _mm_movemask_epi8(_mm_cmpgt_epi32(swapped, rect));
+  return (mask & 0xFF) != 0xFF;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+DirtyRegion::DirtyRegion(size_t max_rects)
+    : max_rects_(max_rects > 0 ? max_rects : 1) {
+}
+
+void DirtyRegion::Add(const RECT& rect) {
+  Rect dirty(rect);
+  if (dirty.IsEmpty())
+    return;
+
+  // Merging can make the new rectangle overlap others that it did not
+  // overlap before, so keep merging until it is disjoint from the rest.
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (auto it = rects_.begin(); it != rects_.end(); ++it) {
+      if (it->Contains(dirty))
+        return;
+      if (dirty.Overlaps(*it)) {
+        dirty.Union(dirty, *it);
+        rects_.erase(it);
+        merged = true;
+        break;
+      }
+    }
+  }
+
+  rects_.push_back(dirty);
+
+  if (rects_.size() > max_rects_) {
+    const Rect bounds = GetBounds();
+    rects_.assign(1, bounds);
+  }
+}
+
+void DirtyRegion::Clear() {
+  rects_.clear();
+}
+
+Rect DirtyRegion::GetBounds() const {
+  return UnionRects(rects_.data(), rects_.size());
+}
+
+bool DirtyRegion::IsEmpty() const {
+  return rects_.empty();
+}
+
+const std::vector<Rect>& DirtyRegion::GetRects() const {
+  return rects_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t IntersectRects(const RECT* rects, size_t count, const RECT& clip,
+                      RECT* output) {
+  size_t result = 0;
+
+#ifdef WIN_GEOMETRY_SSE2
+  const __m128i clip_rect =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&clip));
+  // Selects max for left and top, min for right and bottom
+  const __m128i select = _mm_set_epi32(0, 0, -1, -1);
+
+  for (size_t i = 0; i < count; ++i) {
+    const __m128i rect =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&rects[i]));
+    __m128i overlap = _mm_or_si128(
+        _mm_and_si128(select, Max32(rect, clip_rect)),
+        _mm_andnot_si128(select, Min32(rect, clip_rect)));
+    if (IsEmptyRect(overlap)) {
+      overlap = _mm_setzero_si128();
+    } else {
+      ++result;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&output[i]), overlap);
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    Rect overlap;
+    if (overlap.Intersect(rects[i], clip))
+      ++result;
+    output[i] = overlap;
+  }
+#endif
+
+  return result;
+}
+
+Rect UnionRects(const RECT* rects, size_t count) {
+  Rect result;
+
+#ifdef WIN_GEOMETRY_SSE2
+  __m128i lower = _mm_set1_epi32(INT_MAX);
+  __m128i upper = _mm_set1_epi32(INT_MIN);
+  bool found = false;
+
+  for (size_t i = 0; i < count; ++i) {
+    const __m128i rect =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&rects[i]));
+    if (IsEmptyRect(rect))
+      continue;
+    lower = Min32(lower, rect);
+    upper = Max32(upper, rect);
+    found = true;
+  }
+
+  if (found) {
+    // Left and top from the minimums, right and bottom from the maximums
+    const __m128i select = _mm_set_epi32(0, 0, -1, -1);
+    const __m128i bounds = _mm_or_si128(_mm_and_si128(select, lower),
+                                        _mm_andnot_si128(select, upper));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(static_cast<RECT*>(&result)),
+                     bounds);
+  }
+#else
+  for (size_t i = 0; i < count; ++i)
+    result.Union(result, rects[i]);
+#endif
+
+  return result;
+}
+
+size_t FindRectFromPoint(const RECT* rects, size_t count, const POINT& point) {
+#ifdef WIN_GEOMETRY_SSE2
+  const __m128i pt = _mm_set_epi32(point.y, point.x, point.y, point.x);
+
+  for (size_t i = 0; i < count; ++i) {
+    const __m128i rect =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&rects[i]));
+    // The point is inside if left <= x, top <= y, right > x and bottom > y
+    const int mask = _mm_movemask_epi8(_mm_cmpgt_epi32(rect, pt));
+    if (mask == 0xFF00)
+      return i;
+  }
+#else
+  for (size_t i = 0; i < count; ++i)
+    if (Rect(rects[i]).PtIn(point))
+      return i;
+#endif
+
+  return count;
+}
+
+}  // namespace win
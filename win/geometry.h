@@ -0,0 +1,292 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+// Allows the geometry types to be built and tested on other platforms
+#include <cstdint>
+typedef int BOOL;
+typedef int32_t LONG;
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+struct POINT { LONG x; LONG y; };
+struct SIZE { LONG cx; LONG cy; };
+struct RECT { LONG left; LONG top; LONG right; LONG bottom; };
+typedef const RECT* LPCRECT;
+#endif
+
+namespace win {
+
+class Point : public POINT {
+public:
+  constexpr Point() : POINT{0, 0} {}
+  constexpr Point(LONG x, LONG y) : POINT{x, y} {}
+  constexpr Point(const POINT& point) : POINT{point.x, point.y} {}
+
+  constexpr BOOL operator==(const POINT& point) const {
+    return x == point.x && y == point.y;
+  }
+  constexpr BOOL operator!=(const POINT& point) const {
+    return !(*this == point);
+  }
+  constexpr Point operator+(const POINT& point) const {
+    return Point(x + point.x, y + point.y);
+  }
+  constexpr Point operator-(const POINT& point) const {
+    return Point(x - point.x, y - point.y);
+  }
+
+  void Offset(LONG dx, LONG dy) {
+    x += dx;
+    y += dy;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Size : public SIZE {
+public:
+  constexpr Size() : SIZE{0, 0} {}
+  constexpr Size(LONG cx, LONG cy) : SIZE{cx, cy} {}
+  constexpr Size(const SIZE& size) : SIZE{size.cx, size.cy} {}
+
+  constexpr BOOL operator==(const SIZE& size) const {
+    return cx == size.cx && cy == size.cy;
+  }
+  constexpr BOOL operator!=(const SIZE& size) const {
+    return !(*this == size);
+  }
+
+  constexpr BOOL IsEmpty() const {
+    return cx <= 0 || cy <= 0;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Methods follow the semantics of their user32 counterparts, so that Rect can
+// be used in place of CopyRect, IntersectRect, PtInRect and others.
+
+class Rect : public RECT {
+public:
+  constexpr Rect() : RECT{0, 0, 0, 0} {}
+  constexpr Rect(LONG l, LONG t, LONG r, LONG b) : RECT{l, t, r, b} {}
+  constexpr Rect(const POINT& point, const SIZE& size)
+      : RECT{point.x, point.y, point.x + size.cx, point.y + size.cy} {}
+  constexpr Rect(const RECT& rect)
+      : RECT{rect.left, rect.top, rect.right, rect.bottom} {}
+  constexpr Rect(LPCRECT rect)
+      : RECT{rect->left, rect->top, rect->right, rect->bottom} {}
+
+  constexpr BOOL operator==(const RECT& rect) const {
+    return Equal(rect);
+  }
+  constexpr BOOL operator!=(const RECT& rect) const {
+    return !Equal(rect);
+  }
+  Rect& operator=(const RECT& rect) {
+    Copy(rect);
+    return *this;
+  }
+
+  constexpr LONG Height() const { return bottom - top; }
+  constexpr LONG Width() const { return right - left; }
+
+  constexpr Point BottomRight() const { return Point(right, bottom); }
+  constexpr Point TopLeft() const { return Point(left, top); }
+  constexpr Size GetSize() const { return Size(Width(), Height()); }
+
+  constexpr BOOL Contains(const RECT& rect) const {
+    return rect.left >= left && rect.top >= top &&
+           rect.right <= right && rect.bottom <= bottom;
+  }
+  constexpr BOOL Equal(const RECT& rect) const {
+    return left == rect.left && top == rect.top &&
+           right == rect.right && bottom == rect.bottom;
+  }
+  constexpr BOOL IsEmpty() const {
+    return right <= left || bottom <= top;
+  }
+  constexpr BOOL Overlaps(const RECT& rect) const {
+    return left < rect.right && rect.left < right &&
+           top < rect.bottom && rect.top < bottom;
+  }
+  constexpr BOOL PtIn(POINT point) const {
+    return point.x >= left && point.x < right &&
+           point.y >= top && point.y < bottom;
+  }
+
+  void Copy(const RECT& rect) {
+    left = rect.left;
+    top = rect.top;
+    right = rect.right;
+    bottom = rect.bottom;
+  }
+
+  BOOL Inflate(LONG dx, LONG dy) {
+    left -= dx;
+    top -= dy;
+    right += dx;
+    bottom += dy;
+    return TRUE;
+  }
+
+  BOOL Intersect(const RECT& rect1, const RECT& rect2) {
+    const Rect result(
+        rect1.left > rect2.left ? rect1.left : rect2.left,
+        rect1.top > rect2.top ? rect1.top : rect2.top,
+        rect1.right < rect2.right ? rect1.right : rect2.right,
+        rect1.bottom < rect2.bottom ? rect1.bottom : rect2.bottom);
+    if (result.IsEmpty()) {
+      SetEmpty();
+      return FALSE;
+    }
+    Copy(result);
+    return TRUE;
+  }
+
+  BOOL Offset(LONG dx, LONG dy) {
+    left += dx;
+    top += dy;
+    right += dx;
+    bottom += dy;
+    return TRUE;
+  }
+
+  BOOL Set(LONG l, LONG t, LONG r, LONG b) {
+    left = l;
+    top = t;
+    right = r;
+    bottom = b;
+    return TRUE;
+  }
+
+  BOOL SetEmpty() {
+    return Set(0, 0, 0, 0);
+  }
+
+  // Only succeeds in making the rectangle smaller if rect2 covers rect1
+  // completely in one dimension, as SubtractRect does.
+  BOOL Subtract(const RECT& rect1, const RECT& rect2) {
+    Rect result(rect1);
+    if (result.IsEmpty()) {
+      SetEmpty();
+      return FALSE;
+    }
+
+    Rect overlap;
+    if (overlap.Intersect(rect1, rect2)) {
+      if (overlap.Equal(rect1)) {
+        SetEmpty();
+        return FALSE;
+      }
+      if (overlap.left == result.left && overlap.right == result.right) {
+        if (overlap.top == result.top)
+          result.top = overlap.bottom;
+        else if (overlap.bottom == result.bottom)
+          result.bottom = overlap.top;
+      } else if (overlap.top == result.top && overlap.bottom == result.bottom) {
+        if (overlap.left == result.left)
+          result.left = overlap.right;
+        else if (overlap.right == result.right)
+          result.right = overlap.left;
+      }
+    }
+
+    Copy(result);
+    return TRUE;
+  }
+
+  BOOL Union(const RECT& rect1, const RECT& rect2) {
+    const Rect a(rect1);
+    const Rect b(rect2);
+    if (a.IsEmpty()) {
+      if (b.IsEmpty()) {
+        SetEmpty();
+        return FALSE;
+      }
+      Copy(b);
+    } else if (b.IsEmpty()) {
+      Copy(a);
+    } else {
+      Set(a.left < b.left ? a.left : b.left,
+          a.top < b.top ? a.top : b.top,
+          a.right > b.right ? a.right : b.right,
+          a.bottom > b.bottom ? a.bottom : b.bottom);
+    }
+    return TRUE;
+  }
+};
+
+static_assert(sizeof(Point) == sizeof(POINT), "Point must match POINT");
+static_assert(sizeof(Size) == sizeof(SIZE), "Size must match SIZE");
+static_assert(sizeof(Rect) == sizeof(RECT), "Rect must match RECT");
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Accumulates dirty rectangles as a small set of disjoint rectangles.
+// Overlapping rectangles are merged into their bounds, and the whole set
+// collapses into a single bounding rectangle when it grows past max_rects.
+
+class DirtyRegion {
+public:
+  DirtyRegion(size_t max_rects = 8);
+
+  void Add(const RECT& rect);
+  void Clear();
+
+  Rect GetBounds() const;
+  bool IsEmpty() const;
+  const std::vector<Rect>& GetRects() const;
+
+private:
+  size_t max_rects_;
+  std::vector<Rect> rects_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Batch operations, vectorized where SSE2 is available
+
+// Writes the intersection of each rectangle with the clip rectangle, or an
+// empty rectangle if they do not intersect. Returns the number of non-empty
+// results.
+size_t IntersectRects(const RECT* rects, size_t count, const RECT& clip,
+                      RECT* output);
+
+// Returns the bounding rectangle of all non-empty rectangles.
+Rect UnionRects(const RECT* rects, size_t count);
+
+// Returns the index of the first rectangle that contains the point, or count
+// if there is none.
+size_t FindRectFromPoint(const RECT* rects, size_t count, const POINT& point);
+
+}  // namespace win
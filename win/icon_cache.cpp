@@ -0,0 +1,227 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <vector>
+
+#include "icon_cache.h"
+#include "raster.h"
+#include "surface.h"
+#include "wic.h"
+
+namespace win {
+
+bool IsIconFile(const std::wstring& file) {
+  const size_t pos = file.find_last_of(L'.');
+  return pos != std::wstring::npos &&
+         ::CompareStringOrdinal(file.c_str() + pos, -1, L".ico", -1,
+                                TRUE) == CSTR_EQUAL;
+}
+
+// Other image formats are decoded at the icon size. Icons use straight
+// alpha, and the mask is ignored for 32-bit color bitmaps with alpha.
+HICON LoadIconFile(const std::wstring& file, int cx, int cy) {
+  if (IsIconFile(file)) {
+    return reinterpret_cast<HICON>(::LoadImage(
+        nullptr, file.c_str(), IMAGE_ICON, cx, cy, LR_LOADFROMFILE));
+  }
+
+  Surface surface;
+  if (!DecodeImage(file, cx, cy, surface))
+    return nullptr;
+
+  const SIZE size = surface.GetSize();
+  UnpremultiplyPixels(surface.GetPixels(), surface.GetStride(),
+                      surface.GetPixels(), surface.GetStride(),
+                      size.cx, size.cy);
+
+  std::vector<BYTE> mask_bits(((size.cx + 15) / 16) * 2 * size.cy);
+  HBITMAP mask = ::CreateBitmap(size.cx, size.cy, 1, 1, mask_bits.data());
+  HBITMAP color = surface.DetachBitmap();
+
+  ICONINFO info = {TRUE, 0, 0, mask, color};
+  HICON icon = ::CreateIconIndirect(&info);
+
+  ::DeleteObject(color);
+  ::DeleteObject(mask);
+
+  return icon;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IconCache::IconCache() {
+}
+
+IconCache::~IconCache() {
+  for (const auto& it : references_)
+    ::DestroyIcon(it.first);
+}
+
+HICON IconCache::Load(HINSTANCE instance, int resource, IconSize size,
+                      UINT dpi) {
+  return Load(instance, resource, GetIconMetric(size, false, dpi),
+              GetIconMetric(size, true, dpi));
+}
+
+HICON IconCache::Load(HINSTANCE instance, int resource, int cx, int cy) {
+  return Acquire(Key(instance, resource, std::wstring(), std::wstring(),
+                     cx, cy));
+}
+
+HICON IconCache::LoadFile(const std::wstring& file, int cx, int cy) {
+  return Acquire(Key(nullptr, 0, file, std::wstring(), cx, cy));
+}
+
+HICON IconCache::LoadFile(const std::wstring& file, int cx, int cy,
+                          const std::wstring& loader_name, FileLoader loader) {
+  return Acquire(Key(nullptr, 0, file, loader_name, cx, cy), loader);
+}
+
+void IconCache::Preload(HINSTANCE instance, int resource, UINT dpi) {
+  Lock lock(critical_section_);
+
+  for (auto size : {kIconSmall, kIconLarge}) {
+    HICON icon = Load(instance, resource, size, dpi);
+    if (!icon)
+      continue;
+    // Only one reference is kept for each preloaded icon
+    Icon& entry = references_[icon];
+    if (entry.preloaded) {
+      entry.references--;
+    } else {
+      entry.preloaded = true;
+    }
+  }
+}
+
+HICON IconCache::AddRef(HICON icon) {
+  Lock lock(critical_section_);
+
+  auto it = references_.find(icon);
+  if (it == references_.end())
+    return nullptr;
+
+  it->second.references++;
+  return icon;
+}
+
+bool IconCache::Release(HICON icon) {
+  Lock lock(critical_section_);
+
+  auto it = references_.find(icon);
+  if (it == references_.end())
+    return false;
+
+  if (--it->second.references == 0) {
+    icons_.erase(it->second.key);
+    references_.erase(it);
+    ::DestroyIcon(icon);
+  }
+
+  return true;
+}
+
+void IconCache::Clear() {
+  Lock lock(critical_section_);
+
+  std::vector<HICON> preloaded;
+  for (auto& it : references_) {
+    if (it.second.preloaded) {
+      it.second.preloaded = false;
+      preloaded.push_back(it.first);
+    }
+  }
+
+  for (auto icon : preloaded)
+    Release(icon);
+}
+
+int IconCache::GetIconMetric(IconSize size, bool height, UINT dpi) {
+  const int index = size == kIconSmall ?
+      (height ? SM_CYSMICON : SM_CXSMICON) :
+      (height ? SM_CYICON : SM_CXICON);
+
+  if (dpi == 0)
+    return ::GetSystemMetrics(index);
+
+  // Available since Windows 10, version 1607
+  typedef int (WINAPI* _GetSystemMetricsForDpi)(int nIndex, UINT dpi);
+  static const auto get_system_metrics_for_dpi =
+      reinterpret_cast<_GetSystemMetricsForDpi>(::GetProcAddress(
+          ::GetModuleHandle(L"user32.dll"), "GetSystemMetricsForDpi"));
+  if (get_system_metrics_for_dpi)
+    return get_system_metrics_for_dpi(index, dpi);
+
+  HDC hdc = ::GetDC(nullptr);
+  const int system_dpi = ::GetDeviceCaps(hdc, LOGPIXELSY);
+  ::ReleaseDC(nullptr, hdc);
+
+  return ::MulDiv(::GetSystemMetrics(index), dpi, system_dpi);
+}
+
+HICON IconCache::Acquire(const Key& key, const FileLoader& loader) {
+  Lock lock(critical_section_);
+
+  auto it = icons_.find(key);
+  if (it != icons_.end()) {
+    references_[it->second].references++;
+    return it->second;
+  }
+
+  const std::wstring& file = std::get<2>(key);
+  const int cx = std::get<4>(key);
+  const int cy = std::get<5>(key);
+
+  HICON icon = nullptr;
+  if (!file.empty()) {
+    icon = loader ? loader(file, cx, cy) : LoadIconFile(file, cx, cy);
+  } else {
+    icon = reinterpret_cast<HICON>(::LoadImage(
+        std::get<0>(key), MAKEINTRESOURCE(std::get<1>(key)), IMAGE_ICON,
+        cx, cy, LR_DEFAULTCOLOR));
+  }
+
+  if (!icon)
+    return nullptr;
+
+  icons_[key] = icon;
+  Icon entry = {key, 1, false};
+  references_[icon] = entry;
+
+  return icon;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IconCache& GetIconCache() {
+  static IconCache icon_cache;
+  return icon_cache;
+}
+
+void ReleaseIcon(HICON icon) {
+  if (icon && !GetIconCache().Release(icon))
+    ::DestroyIcon(icon);
+}
+
+}  // namespace win
@@ -0,0 +1,103 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <windows.h>
+
+#include "thread.h"
+
+namespace win {
+
+enum IconSize {
+  kIconSmall,
+  kIconLarge
+};
+
+// Shares icons between windows, image lists and notification icons. Each
+// icon is loaded once per module, resource or file, size and DPI, and
+// destroyed when its last reference is released.
+
+class IconCache {
+public:
+  typedef std::function<HICON(const std::wstring& file,
+                              int cx, int cy)> FileLoader;
+
+  IconCache();
+  ~IconCache();
+
+  // Zero DPI selects the system DPI.
+  HICON Load(HINSTANCE instance, int resource, IconSize size, UINT dpi = 0);
+  HICON Load(HINSTANCE instance, int resource, int cx, int cy);
+  // Files are decoded through WIC (see wic.h). Zero keeps the original
+  // dimension.
+  HICON LoadFile(const std::wstring& file, int cx, int cy);
+  // Decodes through another loader. Icons are cached separately for each
+  // loader name, which must not be empty.
+  HICON LoadFile(const std::wstring& file, int cx, int cy,
+                 const std::wstring& loader_name, FileLoader loader);
+
+  // Loads both sizes for a DPI ahead of time, and keeps them until the cache
+  // is cleared.
+  void Preload(HINSTANCE instance, int resource, UINT dpi = 0);
+
+  HICON AddRef(HICON icon);
+  // Returns false for icons that were not loaded through the cache.
+  bool Release(HICON icon);
+
+  // Releases the icons kept by Preload. Icons that are still in use are
+  // destroyed when their last reference is released.
+  void Clear();
+
+  static int GetIconMetric(IconSize size, bool height, UINT dpi);
+
+private:
+  // Module, resource, file, loader name, width, height
+  typedef std::tuple<HINSTANCE, int, std::wstring, std::wstring,
+                     int, int> Key;
+
+  struct Icon {
+    Key key;
+    int references;
+    bool preloaded;
+  };
+
+  HICON Acquire(const Key& key, const FileLoader& loader = nullptr);
+
+  std::map<Key, HICON> icons_;
+  std::map<HICON, Icon> references_;
+  CriticalSection critical_section_;
+};
+
+IconCache& GetIconCache();
+
+// Releases an icon of the cache, or destroys any other icon.
+void ReleaseIcon(HICON icon);
+
+}  // namespace win
@@ -0,0 +1,334 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "image_loader.h"
+#include "thumbnail_cache.h"
+#include "wic.h"
+
+namespace win {
+
+const size_t kDefaultCacheBytes = 64 * 1024 * 1024;
+const size_t kDefaultCacheHandles = 1000;
+// Each surface holds a bitmap and a memory DC
+const size_t kHandlesPerImage = 2;
+
+class ImageLoader::Worker : public Thread {
+public:
+  Worker(ImageLoader& loader)
+      : loader_(loader) {
+  }
+
+  ~Worker() {
+    if (GetThreadHandle())
+      ::WaitForSingleObject(GetThreadHandle(), INFINITE);
+  }
+
+  DWORD ThreadProc() {
+    // Decoding should not compete with the UI thread
+    ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    const HRESULT hr = ::CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    UINT id = 0;
+    Request request;
+    while (loader_.Dequeue(id, request)) {
+      // The same image may have been decoded for an earlier request
+      Image image = loader_.Find(request.file, request.width, request.height);
+      if (!image) {
+        auto surface = std::make_shared<Surface>();
+        if (LoadImage(request, *surface))
+          image = surface;
+      }
+      loader_.Complete(id, request, image);
+    }
+
+    if (SUCCEEDED(hr)) {
+      ReleaseImagingFactory();
+      ::CoUninitialize();
+    }
+    return 0;
+  }
+
+private:
+  bool LoadImage(const Request& request, Surface& surface) {
+    ThumbnailCache* thumbnail_cache = loader_.thumbnail_cache_;
+    if (thumbnail_cache && thumbnail_cache->Get(request.file, request.width,
+                                                request.height, surface))
+      return true;
+
+    if (!DecodeImage(request.file, request.width, request.height, surface))
+      return false;
+
+    if (thumbnail_cache)
+      thumbnail_cache->Put(request.file, request.width, request.height,
+                           surface);
+    return true;
+  }
+
+  ImageLoader& loader_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+ImageLoader::ImageLoader()
+    : hwnd_(nullptr),
+      message_(0),
+      next_id_(1),
+      stopping_(false),
+      cache_(kDefaultCacheBytes),
+      cache_handles_(kDefaultCacheHandles),
+      thumbnail_cache_(nullptr) {
+  work_event_.Create(nullptr, TRUE, FALSE, nullptr);
+}
+
+ImageLoader::~ImageLoader() {
+  Stop();
+}
+
+bool ImageLoader::Start(HWND hwnd, UINT message, int threads) {
+  if (!workers_.empty() || !hwnd)
+    return false;
+
+  if (threads <= 0) {
+    SYSTEM_INFO system_info;
+    ::GetSystemInfo(&system_info);
+    // Leave a processor for the UI thread
+    threads = static_cast<int>(system_info.dwNumberOfProcessors) - 1;
+    if (threads > 4)
+      threads = 4;
+    if (threads < 1)
+      threads = 1;
+  }
+
+  {
+    Lock lock(critical_section_);
+    hwnd_ = hwnd;
+    message_ = message;
+    stopping_ = false;
+  }
+
+  for (int i = 0; i < threads; ++i) {
+    std::unique_ptr<Worker> worker(new Worker(*this));
+    if (!worker->CreateThread(nullptr, 0, 0))
+      break;
+    workers_.push_back(std::move(worker));
+  }
+
+  return !workers_.empty();
+}
+
+void ImageLoader::Stop() {
+  {
+    Lock lock(critical_section_);
+    stopping_ = true;
+    work_event_.Set();
+  }
+
+  // Workers finish the image they are decoding before they exit
+  workers_.clear();
+
+  CancelAll();
+}
+
+ImageLoader::Image ImageLoader::Find(const std::wstring& file,
+                                     UINT width, UINT height) {
+  Lock lock(critical_section_);
+  Image* image = cache_.Get(CacheKey(file, width, height));
+  return image ? *image : nullptr;
+}
+
+UINT ImageLoader::Load(const std::wstring& file, UINT width, UINT height,
+                       int priority, LPARAM param) {
+  Lock lock(critical_section_);
+
+  if (workers_.empty() || stopping_)
+    return 0;
+
+  const UINT id = next_id_++;
+  if (next_id_ == 0)
+    next_id_ = 1;
+
+  Request request = {file, width, height, priority, param};
+  requests_[id] = request;
+  queue_.insert(QueueKey(-priority, id));
+  work_event_.Set();
+
+  return id;
+}
+
+bool ImageLoader::SetPriority(UINT id, int priority) {
+  Lock lock(critical_section_);
+
+  auto it = requests_.find(id);
+  if (it == requests_.end())
+    return false;
+
+  queue_.erase(QueueKey(-it->second.priority, id));
+  it->second.priority = priority;
+  queue_.insert(QueueKey(-priority, id));
+
+  return true;
+}
+
+bool ImageLoader::Cancel(UINT id) {
+  Lock lock(critical_section_);
+
+  auto it = requests_.find(id);
+  if (it != requests_.end()) {
+    queue_.erase(QueueKey(-it->second.priority, id));
+    requests_.erase(it);
+    return true;
+  }
+
+  return decoding_.erase(id) > 0 || results_.erase(id) > 0;
+}
+
+void ImageLoader::CancelAll() {
+  Lock lock(critical_section_);
+
+  requests_.clear();
+  queue_.clear();
+  decoding_.clear();
+  results_.clear();
+}
+
+void ImageLoader::CancelIf(std::function<bool(LPARAM param)> predicate) {
+  Lock lock(critical_section_);
+
+  for (auto it = requests_.begin(); it != requests_.end(); ) {
+    if (predicate(it->second.param)) {
+      queue_.erase(QueueKey(-it->second.priority, it->first));
+      it = requests_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = decoding_.begin(); it != decoding_.end(); ) {
+    if (predicate(it->second)) {
+      it = decoding_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = results_.begin(); it != results_.end(); ) {
+    if (predicate(it->second.param)) {
+      it = results_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool ImageLoader::TakeResult(UINT id, Result& result) {
+  Lock lock(critical_section_);
+
+  auto it = results_.find(id);
+  if (it == results_.end())
+    return false;
+
+  result = std::move(it->second);
+  results_.erase(it);
+
+  return true;
+}
+
+void ImageLoader::ClearCache() {
+  Lock lock(critical_section_);
+  cache_.Clear();
+}
+
+void ImageLoader::SetCacheLimits(size_t bytes, size_t handles) {
+  Lock lock(critical_section_);
+  cache_.SetCapacity(bytes);
+  cache_handles_ = handles;
+  TrimCache();
+}
+
+void ImageLoader::SetThumbnailCache(ThumbnailCache* thumbnail_cache) {
+  if (workers_.empty())
+    thumbnail_cache_ = thumbnail_cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Blocks until a request is available, or returns false when stopping.
+bool ImageLoader::Dequeue(UINT& id, Request& request) {
+  while (true) {
+    {
+      Lock lock(critical_section_);
+
+      if (stopping_)
+        return false;
+
+      if (!queue_.empty()) {
+        id = queue_.begin()->second;
+        queue_.erase(queue_.begin());
+
+        auto it = requests_.find(id);
+        request = std::move(it->second);
+        requests_.erase(it);
+        decoding_[id] = request.param;
+
+        return true;
+      }
+
+      // The event is only set and reset while locked, so a request cannot be
+      // missed in between.
+      work_event_.Reset();
+    }
+
+    work_event_.Wait();
+  }
+}
+
+void ImageLoader::Complete(UINT id, const Request& request, Image image) {
+  Lock lock(critical_section_);
+
+  // Images of canceled requests are still cached, as they are likely to be
+  // requested again.
+  if (image) {
+    const CacheKey key(request.file, request.width, request.height);
+    if (!cache_.Peek(key)) {
+      const SIZE size = image->GetSize();
+      cache_.Put(key, image, static_cast<size_t>(size.cx) * size.cy * 4);
+      TrimCache();
+    }
+  }
+
+  if (!decoding_.erase(id))
+    return;
+
+  Result result = {request.file, request.param, image};
+  results_[id] = result;
+
+  if (!::PostMessage(hwnd_, message_, id, 0))
+    results_.erase(id);
+}
+
+void ImageLoader::TrimCache() {
+  while (cache_.size() * kHandlesPerImage > cache_handles_ &&
+         cache_.EraseOldest()) {
+  }
+}
+
+}  // namespace win
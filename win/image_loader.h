@@ -0,0 +1,130 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include "lru_cache.h"
+#include "surface.h"
+#include "thread.h"
+
+namespace win {
+
+class ThumbnailCache;
+
+// Decodes images on worker threads (see wic.h), keeping them in a cache that
+// is bounded by both memory and GDI handles. Finished requests are announced
+// by posting a message to a window, with the request ID as WPARAM. The
+// window then takes the result on its own thread.
+
+class ImageLoader {
+public:
+  // Images are shared with the cache, so they cannot be modified or have
+  // their bitmaps detached. Copy an image into a new surface to own it.
+  typedef std::shared_ptr<const Surface> Image;
+
+  struct Result {
+    std::wstring file;
+    LPARAM param;
+    Image image;  // nullptr if the image could not be decoded
+  };
+
+  ImageLoader();
+  ~ImageLoader();
+
+  // Zero threads selects a count based on the processor.
+  bool Start(HWND hwnd, UINT message, int threads = 0);
+  void Stop();
+
+  // Returns a cached image, without queueing a request.
+  Image Find(const std::wstring& file, UINT width, UINT height);
+
+  // Requests with a higher priority are decoded first, and requests of the
+  // same priority in the order they were made. Returns zero on failure.
+  UINT Load(const std::wstring& file, UINT width, UINT height,
+            int priority = 0, LPARAM param = 0);
+  bool SetPriority(UINT id, int priority);
+
+  // Canceled requests are not decoded if they are still queued, and their
+  // results are discarded otherwise.
+  bool Cancel(UINT id);
+  void CancelAll();
+  void CancelIf(std::function<bool(LPARAM param)> predicate);
+
+  bool TakeResult(UINT id, Result& result);
+
+  void ClearCache();
+  void SetCacheLimits(size_t bytes, size_t handles);
+  // Decoded images are also kept in a persistent cache, if one is set. It
+  // must be set before the loader is started.
+  void SetThumbnailCache(ThumbnailCache* thumbnail_cache);
+
+private:
+  class Worker;
+
+  struct Request {
+    std::wstring file;
+    UINT width;
+    UINT height;
+    int priority;
+    LPARAM param;
+  };
+
+  typedef std::tuple<std::wstring, UINT, UINT> CacheKey;
+  typedef std::pair<int, UINT> QueueKey;  // negated priority, ID
+
+  bool Dequeue(UINT& id, Request& request);
+  void Complete(UINT id, const Request& request, Image image);
+  void TrimCache();
+
+  HWND hwnd_;
+  UINT message_;
+  UINT next_id_;
+  bool stopping_;
+
+  std::map<UINT, Request> requests_;
+  std::set<QueueKey> queue_;
+  std::map<UINT, LPARAM> decoding_;
+  std::map<UINT, Result> results_;
+
+  LruCache<CacheKey, Image> cache_;
+  size_t cache_handles_;
+  ThumbnailCache* thumbnail_cache_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  CriticalSection critical_section_;
+  Event work_event_;
+};
+
+}  // namespace win
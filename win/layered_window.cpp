@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "layered_window.h"
+
+namespace win {
+
+LayeredSurface::LayeredSurface()
+    : resized_(false) {
+}
+
+bool LayeredSurface::Create(int width, int height) {
+  SIZE size = GetSize();
+  if (GetBitmap() && width == size.cx && height == size.cy)
+    return true;
+
+  if (!Surface::Create(width, height)) {
+    Destroy();
+    return false;
+  }
+
+  dirty_ = Rect(0, 0, width, height);
+  resized_ = true;
+
+  return true;
+}
+
+void LayeredSurface::Destroy() {
+  Surface::Destroy();
+
+  dirty_.SetEmpty();
+  resized_ = false;
+}
+
+void LayeredSurface::Clear(const RECT& rect) {
+  Rect area;
+  SIZE size = GetSize();
+  if (!area.Intersect(rect, Rect(0, 0, size.cx, size.cy)))
+    return;
+
+  Fill(area, 0);
+  Invalidate(area);
+}
+
+void LayeredSurface::Invalidate() {
+  SIZE size = GetSize();
+  dirty_ = Rect(0, 0, size.cx, size.cy);
+}
+
+void LayeredSurface::Invalidate(const RECT& rect) {
+  Rect area;
+  SIZE size = GetSize();
+  if (area.Intersect(rect, Rect(0, 0, size.cx, size.cy)))
+    dirty_.Union(dirty_, area);
+}
+
+BOOL LayeredSurface::Update(HWND hwnd, const POINT* position, BYTE alpha) {
+  HDC dc = GetDc();
+  if (!dc)
+    return FALSE;
+
+  // Drawing through the DC may still be batched
+  ::GdiFlush();
+
+  BLENDFUNCTION blend = {AC_SRC_OVER, 0, alpha, AC_SRC_ALPHA};
+  POINT source = {0, 0};
+  SIZE size = GetSize();
+
+  UPDATELAYEREDWINDOWINFO info = {0};
+  info.cbSize = sizeof(UPDATELAYEREDWINDOWINFO);
+  info.pptDst = position;
+  info.pblend = &blend;
+  info.dwFlags = ULW_ALPHA;
+
+  // Without new content only the position and alpha are updated. The whole
+  // surface must be submitted when the window size changes.
+  if (resized_ || !dirty_.IsEmpty()) {
+    info.hdcSrc = dc;
+    info.pptSrc = &source;
+    info.psize = &size;
+    info.prcDirty = resized_ ? nullptr : &dirty_;
+  }
+
+  BOOL result = ::UpdateLayeredWindowIndirect(hwnd, &info);
+  if (result) {
+    dirty_.SetEmpty();
+    resized_ = false;
+  }
+
+  return result;
+}
+
+}  // namespace win
@@ -0,0 +1,58 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include "geometry.h"
+#include "surface.h"
+
+namespace win {
+
+// A surface holding the premultiplied ARGB pixels of a layered window. Only
+// the part of the surface that has been invalidated is submitted on each
+// update.
+
+class LayeredSurface : public Surface {
+public:
+  LayeredSurface();
+
+  bool Create(int width, int height);
+  void Destroy();
+
+  // GDI does not write alpha, so pixels drawn through the DC must be fixed up
+  // before the surface is updated.
+  void Clear(const RECT& rect);
+  void Invalidate();
+  void Invalidate(const RECT& rect);
+
+  BOOL Update(HWND hwnd, const POINT* position = nullptr, BYTE alpha = 255);
+
+private:
+  Rect dirty_;
+  bool resized_;
+};
+
+}  // namespace win
@@ -0,0 +1,153 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <utility>
+
+namespace win {
+
+// A least recently used cache. Each entry has a cost, and the least recently
+// used entries are evicted when the total cost exceeds the capacity.
+
+template <typename Key, typename Value>
+class LruCache {
+public:
+  typedef std::function<void(const Key& key, Value& value)> EvictCallback;
+
+  LruCache(size_t capacity, EvictCallback on_evict = nullptr)
+      : capacity_(capacity),
+        cost_(0),
+        on_evict_(on_evict) {
+  }
+
+  ~LruCache() {
+    Clear();
+  }
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  // Returns nullptr if the key is not found. Found entries become the most
+  // recently used.
+  Value* Get(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->value;
+  }
+
+  Value* Peek(const Key& key) {
+    auto it = index_.find(key);
+    return it != index_.end() ? &it->second->value : nullptr;
+  }
+
+  Value& Put(const Key& key, Value value, size_t cost = 1) {
+    Erase(key);
+
+    entries_.push_front(Entry{key, std::move(value), cost});
+    index_[key] = entries_.begin();
+    cost_ += cost;
+
+    // The new entry is kept even if it exceeds the capacity on its own
+    while (cost_ > capacity_ && entries_.size() > 1)
+      Evict(std::prev(entries_.end()));
+
+    return entries_.front().value;
+  }
+
+  bool Erase(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return false;
+    Evict(it->second);
+    return true;
+  }
+
+  // Evicts the least recently used entry, e.g. to enforce a second limit.
+  bool EraseOldest() {
+    if (entries_.empty())
+      return false;
+    Evict(std::prev(entries_.end()));
+    return true;
+  }
+
+  void Clear() {
+    while (!entries_.empty())
+      Evict(std::prev(entries_.end()));
+  }
+
+  template <typename Predicate>
+  void EraseIf(Predicate predicate) {
+    for (auto it = entries_.begin(); it != entries_.end(); ) {
+      auto next = std::next(it);
+      if (predicate(it->key, it->value))
+        Evict(it);
+      it = next;
+    }
+  }
+
+  void SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    while (cost_ > capacity_ && !entries_.empty())
+      Evict(std::prev(entries_.end()));
+  }
+
+  size_t capacity() const { return capacity_; }
+  size_t cost() const { return cost_; }
+  bool empty() const { return entries_.empty(); }
+  size_t size() const { return entries_.size(); }
+
+private:
+  struct Entry {
+    Key key;
+    Value value;
+    size_t cost;
+  };
+  typedef typename std::list<Entry>::iterator Iterator;
+
+  void Evict(Iterator it) {
+    cost_ -= it->cost;
+    index_.erase(it->key);
+    // Unlink first, so that the callback can safely use the cache
+    Entry entry = std::move(*it);
+    entries_.erase(it);
+    if (on_evict_)
+      on_evict_(entry.key, entry.value);
+  }
+
+  size_t capacity_;
+  size_t cost_;
+  std::list<Entry> entries_;
+  std::map<Key, Iterator> index_;
+  EvictCallback on_evict_;
+};
+
+}  // namespace win
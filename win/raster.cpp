@@ -0,0 +1,706 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "raster.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIN_RASTER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define WIN_RASTER_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WIN_TARGET_AVX2
+#else
+#define WIN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+namespace win {
+
+// Rounded division by 255 for values up to 255 * 255
+inline uint32_t Div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+inline uint32_t* OffsetRow(uint32_t* row, ptrdiff_t stride) {
+  return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(row) + stride);
+}
+
+inline const uint32_t* OffsetRow(const uint32_t* row, ptrdiff_t stride) {
+  return reinterpret_cast<const uint32_t*>(
+      reinterpret_cast<const uint8_t*>(row) + stride);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar
+
+void FillRowScalar(uint32_t* dst, int width, uint32_t color) {
+  for (int x = 0; x < width; ++x)
+    dst[x] = color;
+}
+
+inline uint32_t BlendPixel(uint32_t dst, uint32_t src) {
+  const uint32_t inverse_alpha = 255 - (src >> 24);
+  uint32_t rb = (dst & 0x00FF00FF) * inverse_alpha + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+  uint32_t ag = ((dst >> 8) & 0x00FF00FF) * inverse_alpha + 0x00800080;
+  ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+  return src + (rb | ag);
+}
+
+void BlendRowScalar(uint32_t* dst, const uint32_t* src, int width) {
+  for (int x = 0; x < width; ++x) {
+    const uint32_t alpha = src[x] >> 24;
+    if (alpha == 255) {
+      dst[x] = src[x];
+    } else if (alpha) {
+      dst[x] = BlendPixel(dst[x], src[x]);
+    }
+  }
+}
+
+inline uint32_t TintPixel(uint32_t pixel, uint32_t color) {
+  uint32_t result = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    const uint32_t channel = Div255(((pixel >> shift) & 0xFF) *
+                                    ((color >> shift) & 0xFF));
+    result |= channel << shift;
+  }
+  return result;
+}
+
+void TintRowScalar(uint32_t* dst, int width, uint32_t color) {
+  for (int x = 0; x < width; ++x)
+    dst[x] = TintPixel(dst[x], color);
+}
+
+void ExpandRowScalar(uint32_t* dst, const uint8_t* mask, int width,
+                     uint32_t foreground, uint32_t background) {
+  for (int x = 0; x < width; ++x) {
+    const bool set = (mask[x >> 3] & (0x80 >> (x & 7))) != 0;
+    dst[x] = set ? foreground : background;
+  }
+}
+
+inline uint32_t PremultiplyPixel(uint32_t pixel) {
+  const uint32_t alpha = pixel >> 24;
+  if (alpha == 255)
+    return pixel;
+
+  uint32_t result = pixel & 0xFF000000;
+  for (int shift = 0; shift < 24; shift += 8)
+    result |= Div255(((pixel >> shift) & 0xFF) * alpha) << shift;
+  return result;
+}
+
+void PremultiplyRowScalar(uint32_t* dst, const uint32_t* src, int width) {
+  for (int x = 0; x < width; ++x)
+    dst[x] = PremultiplyPixel(src[x]);
+}
+
+inline uint32_t UnpremultiplyPixel(uint32_t pixel) {
+  const uint32_t alpha = pixel >> 24;
+  if (alpha == 255)
+    return pixel;
+  if (alpha == 0)
+    return 0;
+
+  uint32_t result = pixel & 0xFF000000;
+  for (int shift = 0; shift < 24; shift += 8) {
+    uint32_t channel = (((pixel >> shift) & 0xFF) * 255 + alpha / 2) / alpha;
+    result |= (channel > 255 ? 255 : channel) << shift;
+  }
+  return result;
+}
+
+void UnpremultiplyRowScalar(uint32_t* dst, const uint32_t* src, int width) {
+  for (int x = 0; x < width; ++x)
+    dst[x] = UnpremultiplyPixel(src[x]);
+}
+
+void SwizzleRowScalar(uint32_t* dst, const uint32_t* src, int width) {
+  for (int x = 0; x < width; ++x) {
+    const uint32_t pixel = src[x];
+    dst[x] = (pixel & 0xFF00FF00) |
+             ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE2
+
+#ifdef WIN_RASTER_SSE2
+
+inline __m128i Div255Epi16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+void FillRowSse2(uint32_t* dst, int width, uint32_t color) {
+  const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+  int x = 0;
+  for (; x + 4 <= width; x += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), value);
+  FillRowScalar(dst + x, width - x, color);
+}
+
+void BlendRowSse2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max_alpha = _mm_set1_epi16(255);
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i*>(dst + x));
+
+    // Inverse source alpha in every 16-bit channel of its pixel
+    __m128i alpha = _mm_srli_epi32(s, 24);
+    alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+    const __m128i inverse = _mm_sub_epi16(max_alpha, alpha);
+    const __m128i inverse_lo = _mm_unpacklo_epi32(inverse, inverse);
+    const __m128i inverse_hi = _mm_unpackhi_epi32(inverse, inverse);
+
+    __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+    d_lo = Div255Epi16(_mm_mullo_epi16(d_lo, inverse_lo));
+    d_hi = Div255Epi16(_mm_mullo_epi16(d_hi, inverse_hi));
+
+    const __m128i result = _mm_adds_epu8(s, _mm_packus_epi16(d_lo, d_hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+  }
+
+  BlendRowScalar(dst + x, src + x, width - x);
+}
+
+void TintRowSse2(uint32_t* dst, int width, uint32_t color) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i tint =
+      _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i*>(dst + x));
+    __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+    d_lo = Div255Epi16(_mm_mullo_epi16(d_lo, tint));
+    d_hi = Div255Epi16(_mm_mullo_epi16(d_hi, tint));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     _mm_packus_epi16(d_lo, d_hi));
+  }
+
+  TintRowScalar(dst + x, width - x, color);
+}
+
+inline __m128i SelectMaskBits(__m128i bits, __m128i bit_values,
+                              __m128i foreground, __m128i background) {
+  const __m128i set = _mm_cmpeq_epi32(_mm_and_si128(bits, bit_values),
+                                      bit_values);
+  return _mm_or_si128(_mm_and_si128(set, foreground),
+                      _mm_andnot_si128(set, background));
+}
+
+void ExpandRowSse2(uint32_t* dst, const uint8_t* mask, int width,
+                   uint32_t foreground, uint32_t background) {
+  const __m128i fg = _mm_set1_epi32(static_cast<int>(foreground));
+  const __m128i bg = _mm_set1_epi32(static_cast<int>(background));
+  const __m128i high_bits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+  const __m128i low_bits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i bits = _mm_set1_epi32(mask[x >> 3]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     SelectMaskBits(bits, high_bits, fg, bg));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4),
+                     SelectMaskBits(bits, low_bits, fg, bg));
+  }
+
+  // x is a multiple of 8 here, so the remaining bits start at a byte
+  ExpandRowScalar(dst + x, mask + (x >> 3), width - x, foreground, background);
+}
+
+// Multiplies the color channels by alpha, which is multiplied by 255 instead
+// so that it is kept as is.
+inline __m128i PremultiplyEpi16(__m128i pixels) {
+  __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+  alpha = _mm_or_si128(alpha, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+  return Div255Epi16(_mm_mullo_epi16(pixels, alpha));
+}
+
+void PremultiplyRowSse2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m128i zero = _mm_setzero_si128();
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i lo = PremultiplyEpi16(_mm_unpacklo_epi8(s, zero));
+    const __m128i hi = PremultiplyEpi16(_mm_unpackhi_epi8(s, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     _mm_packus_epi16(lo, hi));
+  }
+
+  PremultiplyRowScalar(dst + x, src + x, width - x);
+}
+
+// Division is exact for these values, so rounding matches the scalar version.
+template <int shift>
+inline __m128i UnpremultiplyChannel(__m128i pixels, __m128 alpha) {
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  const __m128i channel = _mm_and_si128(_mm_srli_epi32(pixels, shift), mask);
+  __m128 value = _mm_mul_ps(_mm_cvtepi32_ps(channel), _mm_set1_ps(255.0f));
+  value = _mm_add_ps(_mm_div_ps(value, alpha), _mm_set1_ps(0.5f));
+  __m128i result = _mm_cvttps_epi32(value);
+  const __m128i over = _mm_cmpgt_epi32(result, mask);
+  result = _mm_or_si128(_mm_and_si128(over, mask),
+                        _mm_andnot_si128(over, result));
+  return _mm_slli_epi32(result, shift);
+}
+
+void UnpremultiplyRowSse2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i alpha = _mm_srli_epi32(s, 24);
+    const __m128 alpha_ps = _mm_cvtepi32_ps(alpha);
+
+    __m128i result = _mm_and_si128(s, alpha_mask);
+    result = _mm_or_si128(result, UnpremultiplyChannel<0>(s, alpha_ps));
+    result = _mm_or_si128(result, UnpremultiplyChannel<8>(s, alpha_ps));
+    result = _mm_or_si128(result, UnpremultiplyChannel<16>(s, alpha_ps));
+
+    // Transparent pixels were divided by zero
+    const __m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     _mm_andnot_si128(transparent, result));
+  }
+
+  UnpremultiplyRowScalar(dst + x, src + x, width - x);
+}
+
+void SwizzleRowSse2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m128i ag_mask = _mm_set1_epi32(0xFF00FF00);
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    const __m128i ag = _mm_and_si128(s, ag_mask);
+    const __m128i rb = _mm_andnot_si128(ag_mask, s);
+    const __m128i br = _mm_or_si128(_mm_srli_epi32(rb, 16),
+                                    _mm_slli_epi32(rb, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     _mm_or_si128(ag, br));
+  }
+
+  SwizzleRowScalar(dst + x, src + x, width - x);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2
+
+#ifdef WIN_RASTER_AVX2
+
+WIN_TARGET_AVX2
+inline __m256i Div255Epi16Avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+WIN_TARGET_AVX2
+void FillRowAvx2(uint32_t* dst, int width, uint32_t color) {
+  const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+  int x = 0;
+  for (; x + 8 <= width; x += 8)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), value);
+  FillRowSse2(dst + x, width - x, color);
+}
+
+// Unpacking and packing both work within 128-bit lanes, so the pixels end up
+// in their original order.
+WIN_TARGET_AVX2
+void BlendRowAvx2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max_alpha = _mm256_set1_epi16(255);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    const __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i*>(dst + x));
+
+    __m256i alpha = _mm256_srli_epi32(s, 24);
+    alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+    const __m256i inverse = _mm256_sub_epi16(max_alpha, alpha);
+    const __m256i inverse_lo = _mm256_unpacklo_epi32(inverse, inverse);
+    const __m256i inverse_hi = _mm256_unpackhi_epi32(inverse, inverse);
+
+    __m256i d_lo = _mm256_unpacklo_epi8(d, zero);
+    __m256i d_hi = _mm256_unpackhi_epi8(d, zero);
+    d_lo = Div255Epi16Avx2(_mm256_mullo_epi16(d_lo, inverse_lo));
+    d_hi = Div255Epi16Avx2(_mm256_mullo_epi16(d_hi, inverse_hi));
+
+    const __m256i result =
+        _mm256_adds_epu8(s, _mm256_packus_epi16(d_lo, d_hi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), result);
+  }
+
+  BlendRowSse2(dst + x, src + x, width - x);
+}
+
+WIN_TARGET_AVX2
+void TintRowAvx2(uint32_t* dst, int width, uint32_t color) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i tint =
+      _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(color)), zero);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i*>(dst + x));
+    __m256i d_lo = _mm256_unpacklo_epi8(d, zero);
+    __m256i d_hi = _mm256_unpackhi_epi8(d, zero);
+    d_lo = Div255Epi16Avx2(_mm256_mullo_epi16(d_lo, tint));
+    d_hi = Div255Epi16Avx2(_mm256_mullo_epi16(d_hi, tint));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_packus_epi16(d_lo, d_hi));
+  }
+
+  TintRowSse2(dst + x, width - x, color);
+}
+
+WIN_TARGET_AVX2
+void ExpandRowAvx2(uint32_t* dst, const uint8_t* mask, int width,
+                   uint32_t foreground, uint32_t background) {
+  const __m256i fg = _mm256_set1_epi32(static_cast<int>(foreground));
+  const __m256i bg = _mm256_set1_epi32(static_cast<int>(background));
+  const __m256i bit_values =
+      _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i bits = _mm256_set1_epi32(mask[x >> 3]);
+    const __m256i set = _mm256_cmpeq_epi32(
+        _mm256_and_si256(bits, bit_values), bit_values);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_blendv_epi8(bg, fg, set));
+  }
+
+  ExpandRowScalar(dst + x, mask + (x >> 3), width - x, foreground, background);
+}
+
+WIN_TARGET_AVX2
+inline __m256i PremultiplyEpi16Avx2(__m256i pixels) {
+  __m256i alpha =
+      _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, 0xFF), 0xFF);
+  alpha = _mm256_or_si256(alpha, _mm256_set1_epi64x(0x00FF000000000000));
+  return Div255Epi16Avx2(_mm256_mullo_epi16(pixels, alpha));
+}
+
+WIN_TARGET_AVX2
+void PremultiplyRowAvx2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m256i zero = _mm256_setzero_si256();
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    const __m256i lo = PremultiplyEpi16Avx2(_mm256_unpacklo_epi8(s, zero));
+    const __m256i hi = PremultiplyEpi16Avx2(_mm256_unpackhi_epi8(s, zero));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_packus_epi16(lo, hi));
+  }
+
+  PremultiplyRowSse2(dst + x, src + x, width - x);
+}
+
+template <int shift>
+WIN_TARGET_AVX2
+inline __m256i UnpremultiplyChannelAvx2(__m256i pixels, __m256 alpha) {
+  const __m256i mask = _mm256_set1_epi32(0xFF);
+  const __m256i channel =
+      _mm256_and_si256(_mm256_srli_epi32(pixels, shift), mask);
+  __m256 value =
+      _mm256_mul_ps(_mm256_cvtepi32_ps(channel), _mm256_set1_ps(255.0f));
+  value = _mm256_add_ps(_mm256_div_ps(value, alpha), _mm256_set1_ps(0.5f));
+  const __m256i result = _mm256_min_epi32(_mm256_cvttps_epi32(value), mask);
+  return _mm256_slli_epi32(result, shift);
+}
+
+WIN_TARGET_AVX2
+void UnpremultiplyRowAvx2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m256i alpha_mask = _mm256_set1_epi32(0xFF000000);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    const __m256i alpha = _mm256_srli_epi32(s, 24);
+    const __m256 alpha_ps = _mm256_cvtepi32_ps(alpha);
+
+    __m256i result = _mm256_and_si256(s, alpha_mask);
+    result = _mm256_or_si256(result, UnpremultiplyChannelAvx2<0>(s, alpha_ps));
+    result = _mm256_or_si256(result, UnpremultiplyChannelAvx2<8>(s, alpha_ps));
+    result = _mm256_or_si256(result, UnpremultiplyChannelAvx2<16>(s, alpha_ps));
+
+    const __m256i transparent =
+        _mm256_cmpeq_epi32(alpha, _mm256_setzero_si256());
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_andnot_si256(transparent, result));
+  }
+
+  UnpremultiplyRowSse2(dst + x, src + x, width - x);
+}
+
+WIN_TARGET_AVX2
+void SwizzleRowAvx2(uint32_t* dst, const uint32_t* src, int width) {
+  const __m256i order = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_shuffle_epi8(s, order));
+  }
+
+  SwizzleRowSse2(dst + x, src + x, width - x);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+RasterLevel DetectRasterLevel() {
+#ifdef WIN_RASTER_AVX2
+#ifdef _MSC_VER
+  int info[4];
+  ::__cpuid(info, 0);
+  if (info[0] >= 7) {
+    ::__cpuid(info, 1);
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    ::__cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    // The operating system must also save the YMM registers
+    if (avx && osxsave && avx2 && (::_xgetbv(0) & 6) == 6)
+      return kRasterAvx2;
+  }
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return kRasterAvx2;
+#endif
+#endif
+
+#ifdef WIN_RASTER_SSE2
+  return kRasterSse2;
+#else
+  return kRasterScalar;
+#endif
+}
+
+struct RasterState {
+  RasterLevel supported;
+  RasterLevel level;
+};
+
+RasterState& GetRasterState() {
+  static RasterState state = {DetectRasterLevel(), DetectRasterLevel()};
+  return state;
+}
+
+RasterLevel GetRasterLevel() {
+  return GetRasterState().level;
+}
+
+void SetRasterLevel(RasterLevel level) {
+  auto& state = GetRasterState();
+  state.level = level < state.supported ? level : state.supported;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void FillPixels(uint32_t* dst, ptrdiff_t dst_stride, int width, int height,
+                uint32_t color) {
+  auto fill_row = FillRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    fill_row = FillRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    fill_row = FillRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y, dst = OffsetRow(dst, dst_stride))
+    fill_row(dst, width, color);
+}
+
+// memcpy is already vectorized by the C runtime
+void CopyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                const uint32_t* src, ptrdiff_t src_stride,
+                int width, int height) {
+  if (width <= 0)
+    return;
+
+  for (int y = 0; y < height; ++y) {
+    std::memmove(dst, src, width * sizeof(uint32_t));
+    dst = OffsetRow(dst, dst_stride);
+    src = OffsetRow(src, src_stride);
+  }
+}
+
+void BlendPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                 const uint32_t* src, ptrdiff_t src_stride,
+                 int width, int height) {
+  auto blend_row = BlendRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    blend_row = BlendRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    blend_row = BlendRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y) {
+    blend_row(dst, src, width);
+    dst = OffsetRow(dst, dst_stride);
+    src = OffsetRow(src, src_stride);
+  }
+}
+
+void TintPixels(uint32_t* dst, ptrdiff_t dst_stride, int width, int height,
+                uint32_t color) {
+  auto tint_row = TintRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    tint_row = TintRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    tint_row = TintRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y, dst = OffsetRow(dst, dst_stride))
+    tint_row(dst, width, color);
+}
+
+void ExpandMask(uint32_t* dst, ptrdiff_t dst_stride,
+                const uint8_t* mask, ptrdiff_t mask_stride,
+                int width, int height,
+                uint32_t foreground, uint32_t background) {
+  auto expand_row = ExpandRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    expand_row = ExpandRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    expand_row = ExpandRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y) {
+    expand_row(dst, mask, width, foreground, background);
+    dst = OffsetRow(dst, dst_stride);
+    mask += mask_stride;
+  }
+}
+
+void PremultiplyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                       const uint32_t* src, ptrdiff_t src_stride,
+                       int width, int height) {
+  auto premultiply_row = PremultiplyRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    premultiply_row = PremultiplyRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    premultiply_row = PremultiplyRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y) {
+    premultiply_row(dst, src, width);
+    dst = OffsetRow(dst, dst_stride);
+    src = OffsetRow(src, src_stride);
+  }
+}
+
+void UnpremultiplyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                         const uint32_t* src, ptrdiff_t src_stride,
+                         int width, int height) {
+  auto unpremultiply_row = UnpremultiplyRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    unpremultiply_row = UnpremultiplyRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    unpremultiply_row = UnpremultiplyRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y) {
+    unpremultiply_row(dst, src, width);
+    dst = OffsetRow(dst, dst_stride);
+    src = OffsetRow(src, src_stride);
+  }
+}
+
+void SwizzlePixels(uint32_t* dst, ptrdiff_t dst_stride,
+                   const uint32_t* src, ptrdiff_t src_stride,
+                   int width, int height) {
+  auto swizzle_row = SwizzleRowScalar;
+#ifdef WIN_RASTER_SSE2
+  if (GetRasterLevel() >= kRasterSse2)
+    swizzle_row = SwizzleRowSse2;
+#endif
+#ifdef WIN_RASTER_AVX2
+  if (GetRasterLevel() >= kRasterAvx2)
+    swizzle_row = SwizzleRowAvx2;
+#endif
+
+  for (int y = 0; y < height; ++y) {
+    swizzle_row(dst, src, width);
+    dst = OffsetRow(dst, dst_stride);
+    src = OffsetRow(src, src_stride);
+  }
+}
+
+}  // namespace win
@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace win {
+
+// Raster kernels for 32-bit premultiplied ARGB pixels (0xAARRGGBB in memory
+// order B, G, R, A). Strides are in bytes. The kernels do not depend on
+// Windows, and use SSE2 or AVX2 when the processor supports them.
+
+void FillPixels(uint32_t* dst, ptrdiff_t dst_stride, int width, int height,
+                uint32_t color);
+
+void CopyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                const uint32_t* src, ptrdiff_t src_stride,
+                int width, int height);
+
+// Composites the source over the destination (Porter-Duff SrcOver).
+void BlendPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                 const uint32_t* src, ptrdiff_t src_stride,
+                 int width, int height);
+
+// Multiplies each channel by the corresponding channel of the color.
+void TintPixels(uint32_t* dst, ptrdiff_t dst_stride, int width, int height,
+                uint32_t color);
+
+// Expands a 1-bit mask (most significant bit first) into the foreground and
+// background colors.
+void ExpandMask(uint32_t* dst, ptrdiff_t dst_stride,
+                const uint8_t* mask, ptrdiff_t mask_stride,
+                int width, int height,
+                uint32_t foreground, uint32_t background);
+
+// Converts between straight and premultiplied alpha. The source and
+// destination may be the same.
+void PremultiplyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                       const uint32_t* src, ptrdiff_t src_stride,
+                       int width, int height);
+void UnpremultiplyPixels(uint32_t* dst, ptrdiff_t dst_stride,
+                         const uint32_t* src, ptrdiff_t src_stride,
+                         int width, int height);
+
+// Swaps the red and blue channels, converting between RGBA and BGRA.
+void SwizzlePixels(uint32_t* dst, ptrdiff_t dst_stride,
+                   const uint32_t* src, ptrdiff_t src_stride,
+                   int width, int height);
+
+enum RasterLevel {
+  kRasterScalar,
+  kRasterSse2,
+  kRasterAvx2
+};
+
+RasterLevel GetRasterLevel();
+// Limits the kernels to the given level, e.g. to compare implementations.
+void SetRasterLevel(RasterLevel level);
+
+}  // namespace win
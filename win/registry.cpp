@@ -22,13 +22,51 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#pragma comment(lib, "ktmw32.lib")
+
 #include <string>
 #include <vector>
 
+#include <ktmw32.h>
+
 #include "registry.h"
 
 namespace win {
 
+// Reads a value into a container of WCHAR or BYTE, reusing its capacity and
+// growing it only when RegGetValue reports that the data does not fit.
+template <class T>
+LSTATUS GetValueData(HKEY key, const std::wstring& value_name, DWORD flags,
+                     T& output) {
+  using value_type = typename T::value_type;
+
+  output.resize(output.capacity());
+  DWORD size = static_cast<DWORD>(output.size() * sizeof(value_type));
+
+  LSTATUS status = ::RegGetValue(key, nullptr, value_name.c_str(), flags,
+                                 nullptr, output.empty() ? nullptr : &output[0],
+                                 &size);
+
+  while (status == ERROR_MORE_DATA ||
+         (status == ERROR_SUCCESS &&
+          size > output.size() * sizeof(value_type))) {
+    output.resize((size + sizeof(value_type) - 1) / sizeof(value_type));
+    size = static_cast<DWORD>(output.size() * sizeof(value_type));
+    status = ::RegGetValue(key, nullptr, value_name.c_str(), flags,
+                           nullptr, &output[0], &size);
+  }
+
+  if (status == ERROR_SUCCESS) {
+    output.resize(size / sizeof(value_type));
+  } else {
+    output.clear();
+  }
+
+  return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Registry::Registry()
     : key_(nullptr) {
 }
@@ -61,68 +99,101 @@ LSTATUS Registry::CreateKey(HKEY key,
       security_attributes, &key_, disposition);
 }
 
+LSTATUS Registry::CreateKeyTransacted(HKEY key,
+                                      const std::wstring& subkey,
+                                      HANDLE transaction,
+                                      DWORD options,
+                                      REGSAM sam_desired,
+                                      LPDWORD disposition) {
+  CloseKey();
+
+  return ::RegCreateKeyTransacted(
+      key, subkey.c_str(), 0, nullptr, options, sam_desired, nullptr, &key_,
+      disposition, transaction, nullptr);
+}
+
 LONG Registry::DeleteKey(const std::wstring& subkey) {
-  return DeleteSubkeys(key_, subkey);
+  // sam_desired must include: DELETE | KEY_ENUMERATE_SUB_KEYS | KEY_QUERY_VALUE
+  return ::RegDeleteTree(key_, subkey.c_str());
 }
 
-LSTATUS Registry::DeleteSubkeys(HKEY root_key, const std::wstring& subkey) {
-  LSTATUS status = ::RegDeleteKey(root_key, subkey.c_str());
+LSTATUS Registry::DeleteValue(const std::wstring& value_name) {
+  return ::RegDeleteValue(key_, value_name.c_str());
+}
 
-  if (status == ERROR_SUCCESS)
-    return status;
+LSTATUS Registry::EnumKeys(std::vector<std::wstring>& output) {
+  // sam_desired must be: KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS
 
-  HKEY key;
-  status = ::RegOpenKeyEx(root_key, subkey.c_str(), 0, KEY_READ, &key);
+  DWORD subkey_count = 0;
+  DWORD max_name_length = 0;
 
+  LSTATUS status = ::RegQueryInfoKey(key_, nullptr, nullptr, nullptr,
+                                     &subkey_count, &max_name_length, nullptr,
+                                     nullptr, nullptr, nullptr, nullptr,
+                                     nullptr);
   if (status != ERROR_SUCCESS)
     return status;
 
-  DWORD subkey_count = 0;
-  std::vector<std::wstring> keys;
-  WCHAR name[MAX_PATH] = {L'\0'};
-
-  if (::RegQueryInfoKey(key, nullptr, nullptr, nullptr, &subkey_count,
-                        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-                        nullptr) == ERROR_SUCCESS) {
-    for (DWORD i = 0; i < subkey_count; i++) {
-      DWORD name_length = MAX_PATH;
-      if (::RegEnumKeyEx(key, i, name, &name_length, nullptr, nullptr, nullptr,
-                         nullptr) == ERROR_SUCCESS) {
-        keys.push_back(name);
-      }
-    }
+  // Maximum length does not include the terminating null character
+  std::vector<WCHAR> name(max_name_length + 1);
+  output.reserve(output.size() + subkey_count);
+
+  for (DWORD i = 0; i < subkey_count; i++) {
+    DWORD name_length = static_cast<DWORD>(name.size());
+    status = ::RegEnumKeyEx(key_, i, name.data(), &name_length, nullptr,
+                            nullptr, nullptr, nullptr);
+    if (status == ERROR_NO_MORE_ITEMS)
+      break;
+    if (status == ERROR_SUCCESS)
+      output.emplace_back(name.data(), name_length);
   }
 
-  for (auto it = keys.begin(); it != keys.end(); ++it) {
-    DeleteSubkeys(key, it->c_str());
-  }
-
-  ::RegCloseKey(key);
-
-  return ::RegDeleteKey(root_key, subkey.c_str());
+  return ERROR_SUCCESS;
 }
 
-LSTATUS Registry::DeleteValue(const std::wstring& value_name) {
-  return ::RegDeleteValue(key_, value_name.c_str());
-}
+LSTATUS Registry::EnumValues(std::vector<RegistryValue>& output) {
+  // sam_desired must include KEY_QUERY_VALUE
 
-void Registry::EnumKeys(std::vector<std::wstring>& output) {
-  // sam_desired must be: KEY_QUERY_VALUE | KEY_ENUMERATE_SUB_KEYS
+  DWORD value_count = 0;
+  DWORD max_name_length = 0;
+  DWORD max_data_size = 0;
 
-  WCHAR name[MAX_PATH] = {0};
-  DWORD subkey_count = 0;
+  LSTATUS status = ::RegQueryInfoKey(key_, nullptr, nullptr, nullptr, nullptr,
+                                     nullptr, nullptr, &value_count,
+                                     &max_name_length, &max_data_size,
+                                     nullptr, nullptr);
+  if (status != ERROR_SUCCESS)
+    return status;
 
-  if (::RegQueryInfoKey(key_, nullptr, nullptr, nullptr, &subkey_count,
-                        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-                        nullptr) == ERROR_SUCCESS) {
-    for (DWORD i = 0; i < subkey_count; i++) {
-      DWORD name_length = MAX_PATH;
-      if (::RegEnumKeyEx(key_, i, name, &name_length, nullptr, nullptr, nullptr,
-                         nullptr) == ERROR_SUCCESS) {
-        output.push_back(name);
-      }
-    }
+  // Buffers are sized once, so that each value costs a single call
+  std::vector<WCHAR> name(max_name_length + 1);
+  std::vector<BYTE> data(max_data_size);
+  output.reserve(output.size() + value_count);
+
+  for (DWORD i = 0; i < value_count; i++) {
+    DWORD name_length = static_cast<DWORD>(name.size());
+    DWORD data_size = static_cast<DWORD>(data.size());
+    DWORD type = REG_NONE;
+    status = ::RegEnumValue(key_, i, name.data(), &name_length, nullptr,
+                            &type, data.empty() ? nullptr : data.data(),
+                            &data_size);
+    if (status == ERROR_NO_MORE_ITEMS)
+      break;
+    if (status != ERROR_SUCCESS)
+      continue;
+
+    output.emplace_back();
+    auto& value = output.back();
+    value.name.assign(name.data(), name_length);
+    value.type = type;
+    value.data.assign(data.begin(), data.begin() + data_size);
   }
+
+  return ERROR_SUCCESS;
+}
+
+HKEY Registry::GetHandle() const {
+  return key_;
 }
 
 LSTATUS Registry::OpenKey(HKEY key, const std::wstring& subkey, DWORD options,
@@ -132,6 +203,15 @@ LSTATUS Registry::OpenKey(HKEY key, const std::wstring& subkey, DWORD options,
   return ::RegOpenKeyEx(key, subkey.c_str(), options, sam_desired, &key_);
 }
 
+LSTATUS Registry::OpenKeyTransacted(HKEY key, const std::wstring& subkey,
+                                    HANDLE transaction, DWORD options,
+                                    REGSAM sam_desired) {
+  CloseKey();
+
+  return ::RegOpenKeyTransacted(key, subkey.c_str(), options, sam_desired,
+                                &key_, transaction, nullptr);
+}
+
 LSTATUS Registry::QueryValue(const std::wstring& value_name, LPDWORD type,
                              LPBYTE data, LPDWORD data_size) {
   return ::RegQueryValueEx(key_, value_name.c_str(), nullptr, type,
@@ -145,16 +225,100 @@ LSTATUS Registry::SetValue(const std::wstring& value_name, DWORD type,
 }
 
 std::wstring Registry::QueryValue(const std::wstring& value_name) {
-  DWORD type = 0;
-  WCHAR buffer[MAX_PATH];
-  DWORD buffer_size = sizeof(buffer);
+  std::wstring output;
+  QueryValue(value_name, output);
+  return output;
+}
+
+LSTATUS Registry::QueryValue(const std::wstring& value_name, DWORD& output) {
+  DWORD size = sizeof(output);
+  return ::RegGetValue(key_, nullptr, value_name.c_str(), RRF_RT_REG_DWORD,
+                       nullptr, &output, &size);
+}
+
+LSTATUS Registry::QueryValue(const std::wstring& value_name,
+                             ULONGLONG& output) {
+  DWORD size = sizeof(output);
+  return ::RegGetValue(key_, nullptr, value_name.c_str(), RRF_RT_REG_QWORD,
+                       nullptr, &output, &size);
+}
+
+LSTATUS Registry::QueryValue(const std::wstring& value_name,
+                             std::vector<BYTE>& output) {
+  return GetValueData(key_, value_name, RRF_RT_REG_BINARY, output);
+}
 
-  if (QueryValue(value_name.c_str(), &type, reinterpret_cast<LPBYTE>(&buffer),
-                 &buffer_size) == ERROR_SUCCESS)
-    if (type == REG_SZ)
-      return buffer;
+LSTATUS Registry::QueryValue(const std::wstring& value_name,
+                             std::vector<std::wstring>& output) {
+  output.clear();
+
+  std::wstring buffer;
+  LSTATUS status = GetValueData(key_, value_name, RRF_RT_REG_MULTI_SZ, buffer);
+
+  if (status == ERROR_SUCCESS) {
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+      size_t end = buffer.find(L'\0', pos);
+      if (end == std::wstring::npos)
+        end = buffer.size();
+      if (end == pos)  // an empty string terminates the list
+        break;
+      output.emplace_back(buffer, pos, end - pos);
+      pos = end + 1;
+    }
+  }
 
-  return std::wstring();
+  return status;
+}
+
+LSTATUS Registry::QueryValue(const std::wstring& value_name,
+                             std::wstring& output, bool expand) {
+  // REG_EXPAND_SZ values are expanded unless RRF_NOEXPAND is specified
+  const DWORD flags = expand ?
+      RRF_RT_REG_SZ :
+      RRF_RT_REG_SZ | RRF_RT_REG_EXPAND_SZ | RRF_NOEXPAND;
+
+  LSTATUS status = GetValueData(key_, value_name, flags, output);
+
+  while (!output.empty() && output.back() == L'\0')
+    output.pop_back();
+
+  return status;
+}
+
+LSTATUS Registry::QueryMultipleValues(
+    const std::vector<std::wstring>& value_names,
+    std::vector<VALENT>& values,
+    std::vector<BYTE>& buffer) {
+  // On success, each ve_valueptr points into the buffer, which is only grown
+  // and can be reused across calls. The function fails if any of the values
+  // does not exist.
+
+  values.resize(value_names.size());
+  for (size_t i = 0; i < value_names.size(); i++) {
+    values[i] = VALENT();
+    values[i].ve_valuename = const_cast<LPWSTR>(value_names[i].c_str());
+  }
+
+  if (values.empty())
+    return ERROR_SUCCESS;
+
+  LSTATUS status = ERROR_SUCCESS;
+
+  do {
+    DWORD buffer_size = static_cast<DWORD>(buffer.size());
+    status = ::RegQueryMultipleValues(
+        key_, values.data(), static_cast<DWORD>(values.size()),
+        buffer.empty() ? nullptr : reinterpret_cast<LPWSTR>(buffer.data()),
+        &buffer_size);
+    if (status == ERROR_MORE_DATA ||
+        (status == ERROR_SUCCESS && buffer_size > buffer.size())) {
+      buffer.resize(buffer_size);
+      status = ERROR_MORE_DATA;
+    }
+  } while (status == ERROR_MORE_DATA);
+
+  return status;
 }
 
 void Registry::SetValue(const std::wstring& value_name,
@@ -163,4 +327,220 @@ void Registry::SetValue(const std::wstring& value_name,
            value.length() * sizeof(WCHAR));
 }
 
-}  // namespace win
\ No newline at end of file
+////////////////////////////////////////////////////////////////////////////////
+
+RegistryTransaction::RegistryTransaction()
+    : transaction_(INVALID_HANDLE_VALUE),
+      committed_(false) {
+}
+
+RegistryTransaction::~RegistryTransaction() {
+  Rollback();
+}
+
+bool RegistryTransaction::Begin(DWORD timeout) {
+  Rollback();
+
+  transaction_ = ::CreateTransaction(nullptr, nullptr, 0, 0, 0, timeout,
+                                     nullptr);
+  committed_ = false;
+
+  return transaction_ != INVALID_HANDLE_VALUE;
+}
+
+bool RegistryTransaction::Commit() {
+  if (transaction_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  committed_ = ::CommitTransaction(transaction_) != FALSE;
+
+  return committed_;
+}
+
+HANDLE RegistryTransaction::Get() const {
+  return transaction_;
+}
+
+bool RegistryTransaction::Rollback() {
+  if (transaction_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  BOOL result = TRUE;
+  if (!committed_)
+    result = ::RollbackTransaction(transaction_);
+
+  ::CloseHandle(transaction_);
+  transaction_ = INVALID_HANDLE_VALUE;
+
+  return result != FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Batches that cannot be written under a transaction are first staged under a
+// sibling key, which is marked as complete only after every value has been
+// written. A complete staging key is then copied over the target key, and is
+// replayed by Recover if the process dies before it is removed.
+const std::wstring kStagingKeySuffix = L".pending";
+const std::wstring kStagingDataKey = L"Data";
+const std::wstring kStagingCompleteValue = L"Complete";
+
+bool RegistryBatch::IsEmpty() const {
+  return writes_.empty();
+}
+
+void RegistryBatch::Clear() {
+  writes_.clear();
+}
+
+void RegistryBatch::SetValue(const std::wstring& subkey,
+                             const std::wstring& value_name,
+                             DWORD type, CONST BYTE* data, DWORD data_size) {
+  auto& value = writes_[subkey][value_name];
+  value.type = type;
+  value.data.assign(data, data + data_size);
+}
+
+void RegistryBatch::SetValue(const std::wstring& subkey,
+                             const std::wstring& value_name,
+                             DWORD value) {
+  SetValue(subkey, value_name, REG_DWORD,
+           reinterpret_cast<CONST BYTE*>(&value), sizeof(value));
+}
+
+void RegistryBatch::SetValue(const std::wstring& subkey,
+                             const std::wstring& value_name,
+                             const std::wstring& value) {
+  SetValue(subkey, value_name, REG_SZ,
+           reinterpret_cast<CONST BYTE*>(value.c_str()),
+           static_cast<DWORD>((value.size() + 1) * sizeof(WCHAR)));
+}
+
+LSTATUS RegistryBatch::Commit(HKEY key, const std::wstring& subkey) {
+  // A previously staged batch must be applied before this one
+  LSTATUS status = Recover(key, subkey);
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  if (writes_.empty())
+    return ERROR_SUCCESS;
+
+  status = ERROR_INVALID_FUNCTION;
+
+  RegistryTransaction transaction;
+  if (transaction.Begin()) {
+    status = Write(key, subkey, transaction.Get());
+    if (status == ERROR_SUCCESS && !transaction.Commit())
+      status = ::GetLastError();
+    if (status != ERROR_SUCCESS)
+      transaction.Rollback();
+  }
+
+  // Nothing has been written if the transaction failed, e.g. because KTM is
+  // not available on the system or for the hive.
+  if (status != ERROR_SUCCESS)
+    status = CommitStaged(key, subkey);
+
+  if (status == ERROR_SUCCESS)
+    writes_.clear();
+
+  return status;
+}
+
+LSTATUS RegistryBatch::Recover(HKEY key, const std::wstring& subkey) {
+  const std::wstring staging_key = subkey + kStagingKeySuffix;
+
+  Registry staging;
+  LSTATUS status = staging.OpenKey(key, staging_key, 0, KEY_QUERY_VALUE);
+  if (status == ERROR_FILE_NOT_FOUND)
+    return ERROR_SUCCESS;
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  DWORD complete = 0;
+  staging.QueryValue(kStagingCompleteValue, complete);
+  staging.CloseKey();
+
+  if (complete) {
+    return Replay(key, subkey);
+  } else {
+    return ::RegDeleteTree(key, staging_key.c_str());
+  }
+}
+
+LSTATUS RegistryBatch::CommitStaged(HKEY key, const std::wstring& subkey) {
+  const std::wstring staging_key = subkey + kStagingKeySuffix;
+
+  LSTATUS status = Write(key, staging_key + L"\\" + kStagingDataKey, nullptr);
+
+  if (status == ERROR_SUCCESS) {
+    Registry staging;
+    status = staging.CreateKey(key, staging_key);
+    if (status == ERROR_SUCCESS) {
+      const DWORD complete = 1;
+      status = staging.SetValue(kStagingCompleteValue, REG_DWORD,
+                                reinterpret_cast<CONST BYTE*>(&complete),
+                                sizeof(complete));
+    }
+  }
+
+  if (status == ERROR_SUCCESS) {
+    return Replay(key, subkey);
+  } else {
+    ::RegDeleteTree(key, staging_key.c_str());
+    return status;
+  }
+}
+
+LSTATUS RegistryBatch::Replay(HKEY key, const std::wstring& subkey) {
+  const std::wstring staging_key = subkey + kStagingKeySuffix;
+
+  Registry source;
+  LSTATUS status = source.OpenKey(key, staging_key + L"\\" + kStagingDataKey,
+                                  0, KEY_READ);
+
+  if (status == ERROR_SUCCESS) {
+    Registry target;
+    status = target.CreateKey(key, subkey, nullptr, REG_OPTION_NON_VOLATILE,
+                              KEY_CREATE_SUB_KEY | KEY_SET_VALUE);
+    if (status == ERROR_SUCCESS)
+      status = ::RegCopyTree(source.GetHandle(), nullptr, target.GetHandle());
+  }
+
+  source.CloseKey();
+
+  // Copying is idempotent, so the staging key is only removed once it has
+  // been applied successfully.
+  if (status == ERROR_SUCCESS || status == ERROR_FILE_NOT_FOUND)
+    status = ::RegDeleteTree(key, staging_key.c_str());
+
+  return status;
+}
+
+LSTATUS RegistryBatch::Write(HKEY key, const std::wstring& subkey,
+                             HANDLE transaction) const {
+  for (const auto& it : writes_) {
+    const std::wstring path =
+        it.first.empty() ? subkey : subkey + L"\\" + it.first;
+
+    Registry registry;
+    LSTATUS status = transaction ?
+        registry.CreateKeyTransacted(key, path, transaction) :
+        registry.CreateKey(key, path);
+    if (status != ERROR_SUCCESS)
+      return status;
+
+    for (const auto& value : it.second) {
+      status = registry.SetValue(
+          value.first, value.second.type,
+          value.second.data.empty() ? nullptr : value.second.data.data(),
+          static_cast<DWORD>(value.second.data.size()));
+      if (status != ERROR_SUCCESS)
+        return status;
+    }
+  }
+
+  return ERROR_SUCCESS;
+}
+
+}  // namespace win
@@ -24,12 +24,20 @@ SOFTWARE.
 
 #pragma once
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include <windows.h>
 
 namespace win {
 
+struct RegistryValue {
+  std::wstring name;
+  DWORD type = REG_NONE;
+  std::vector<BYTE> data;
+};
+
 class Registry {
 public:
   Registry();
@@ -44,20 +52,44 @@ public:
       REGSAM sam_desired = KEY_SET_VALUE,
       LPSECURITY_ATTRIBUTES security_attributes = nullptr,
       LPDWORD disposition = nullptr);
+  LSTATUS CreateKeyTransacted(
+      HKEY key,
+      const std::wstring& subkey,
+      HANDLE transaction,
+      DWORD options = REG_OPTION_NON_VOLATILE,
+      REGSAM sam_desired = KEY_SET_VALUE,
+      LPDWORD disposition = nullptr);
   LONG DeleteKey(const std::wstring& subkey);
   LSTATUS DeleteValue(const std::wstring& value_name);
-  void EnumKeys(std::vector<std::wstring>& output);
+  LSTATUS EnumKeys(std::vector<std::wstring>& output);
+  LSTATUS EnumValues(std::vector<RegistryValue>& output);
+  HKEY GetHandle() const;
   LSTATUS OpenKey(
       HKEY key,
       const std::wstring& subkey,
       DWORD options = 0,
       REGSAM sam_desired = KEY_QUERY_VALUE);
+  LSTATUS OpenKeyTransacted(
+      HKEY key,
+      const std::wstring& subkey,
+      HANDLE transaction,
+      DWORD options = 0,
+      REGSAM sam_desired = KEY_QUERY_VALUE);
   LSTATUS QueryValue(
       const std::wstring& value_name,
       LPDWORD type,
       LPBYTE data,
       LPDWORD data_size);
   std::wstring QueryValue(const std::wstring& value_name);
+  LSTATUS QueryValue(const std::wstring& value_name, DWORD& output);
+  LSTATUS QueryValue(const std::wstring& value_name, ULONGLONG& output);
+  LSTATUS QueryValue(const std::wstring& value_name, std::vector<BYTE>& output);
+  LSTATUS QueryValue(const std::wstring& value_name, std::vector<std::wstring>& output);
+  LSTATUS QueryValue(const std::wstring& value_name, std::wstring& output, bool expand = true);
+  LSTATUS QueryMultipleValues(
+      const std::vector<std::wstring>& value_names,
+      std::vector<VALENT>& values,
+      std::vector<BYTE>& buffer);
   LSTATUS SetValue(
       const std::wstring& value_name,
       DWORD type,
@@ -68,9 +100,66 @@ public:
       const std::wstring& value);
 
 private:
-  LSTATUS DeleteSubkeys(HKEY root_key, const std::wstring& subkey);
-
   HKEY key_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// A Kernel Transaction Manager (KTM) transaction that is rolled back unless it
+// is committed
+
+class RegistryTransaction {
+public:
+  RegistryTransaction();
+  ~RegistryTransaction();
+
+  bool Begin(DWORD timeout = 0);
+  bool Commit();
+  HANDLE Get() const;
+  bool Rollback();
+
+private:
+  HANDLE transaction_;
+  bool committed_;
+};
+
+// Collects value writes in memory and commits them at once, either under a
+// single transaction or through a staging key when transactions are not
+// available. Subkeys are relative to the key that the batch is committed to.
+
+class RegistryBatch {
+public:
+  bool IsEmpty() const;
+  void Clear();
+  void SetValue(
+      const std::wstring& subkey,
+      const std::wstring& value_name,
+      DWORD type,
+      CONST BYTE* data,
+      DWORD data_size);
+  void SetValue(
+      const std::wstring& subkey,
+      const std::wstring& value_name,
+      DWORD value);
+  void SetValue(
+      const std::wstring& subkey,
+      const std::wstring& value_name,
+      const std::wstring& value);
+
+  LSTATUS Commit(HKEY key, const std::wstring& subkey);
+  static LSTATUS Recover(HKEY key, const std::wstring& subkey);
+
+private:
+  struct Value {
+    DWORD type = REG_NONE;
+    std::vector<BYTE> data;
+  };
+
+  LSTATUS CommitStaged(HKEY key, const std::wstring& subkey);
+  static LSTATUS Replay(HKEY key, const std::wstring& subkey);
+  LSTATUS Write(HKEY key, const std::wstring& subkey, HANDLE transaction) const;
+
+  std::map<std::wstring, std::map<std::wstring, Value>> writes_;
+};
+
 }  // namespace win
@@ -0,0 +1,591 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "handle.h"
+#include "registry.h"
+#include "registry_snapshot.h"
+#include "thread.h"
+
+namespace win {
+
+// File layout: a header, followed by the key and value tables, followed by
+// the strings and data they point to. Offsets are relative to the beginning of
+// the file, keys are sorted by path and values are sorted by name within each
+// key, so that lookups can be done with a binary search.
+
+const DWORD kSnapshotMagic = 0x4E535257;  // "WRSN"
+const DWORD kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  DWORD magic;
+  DWORD version;
+  DWORD file_size;
+  DWORD checksum;
+  DWORD key_count;
+  DWORD value_count;
+  DWORD keys_offset;
+  DWORD values_offset;
+};
+
+struct SnapshotKey {
+  DWORD path_offset;
+  DWORD path_length;
+  DWORD first_value;
+  DWORD value_count;
+  DWORD subkey_count;
+  DWORD reserved;
+  FILETIME last_write_time;
+};
+
+struct SnapshotValue {
+  DWORD name_offset;
+  DWORD name_length;
+  DWORD type;
+  DWORD data_offset;
+  DWORD data_size;
+};
+
+struct SnapshotKeyData {
+  std::wstring path;
+  DWORD subkey_count = 0;
+  DWORD value_count = 0;
+  FILETIME last_write_time = {0};
+  std::vector<RegistryValue> values;
+};
+
+DWORD SnapshotChecksum(const BYTE* data, size_t size) {
+  // FNV-1a
+  DWORD hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int CompareSnapshotNames(LPCWSTR a, size_t a_length,
+                         LPCWSTR b, size_t b_length) {
+  return ::CompareStringOrdinal(a, static_cast<int>(a_length),
+                                b, static_cast<int>(b_length),
+                                TRUE) - CSTR_EQUAL;
+}
+
+std::wstring GetSnapshotKeyPath(const std::wstring& subkey,
+                                const std::wstring& key_path) {
+  return key_path.empty() ? subkey : subkey + L"\\" + key_path;
+}
+
+LSTATUS QuerySnapshotKeyInfo(HKEY key, SnapshotKeyData& data) {
+  return ::RegQueryInfoKey(key, nullptr, nullptr, nullptr, &data.subkey_count,
+                           nullptr, nullptr, &data.value_count, nullptr,
+                           nullptr, nullptr, &data.last_write_time);
+}
+
+LSTATUS CollectSnapshotKeys(HKEY key, const std::wstring& subkey,
+                            const std::wstring& key_path,
+                            std::vector<SnapshotKeyData>& output) {
+  Registry registry;
+  LSTATUS status = registry.OpenKey(key, GetSnapshotKeyPath(subkey, key_path),
+                                    0, KEY_READ);
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  SnapshotKeyData data;
+  data.path = key_path;
+  status = QuerySnapshotKeyInfo(registry.GetHandle(), data);
+  if (status == ERROR_SUCCESS)
+    status = registry.EnumValues(data.values);
+
+  std::vector<std::wstring> subkeys;
+  if (status == ERROR_SUCCESS)
+    status = registry.EnumKeys(subkeys);
+
+  registry.CloseKey();
+
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  output.push_back(std::move(data));
+
+  for (const auto& name : subkeys) {
+    status = CollectSnapshotKeys(
+        key, subkey, key_path.empty() ? name : key_path + L"\\" + name,
+        output);
+    if (status != ERROR_SUCCESS)
+      return status;
+  }
+
+  return ERROR_SUCCESS;
+}
+
+DWORD AppendSnapshotData(std::vector<BYTE>& file, const void* data,
+                         size_t size, size_t alignment) {
+  const size_t offset = (file.size() + alignment - 1) & ~(alignment - 1);
+  file.resize(offset + size);
+  if (size)
+    ::memcpy(&file[offset], data, size);
+  return static_cast<DWORD>(offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class SnapshotValidator : public Thread {
+public:
+  SnapshotValidator(const RegistrySnapshot& snapshot, HKEY key,
+                    const std::wstring& subkey, HWND hwnd, UINT message)
+      : snapshot_(snapshot), key_(key), subkey_(subkey),
+        hwnd_(hwnd), message_(message) {
+  }
+
+  ~SnapshotValidator() {
+    if (GetThreadHandle())
+      ::WaitForSingleObject(GetThreadHandle(), INFINITE);
+  }
+
+  DWORD ThreadProc() {
+    const bool valid = snapshot_.Validate(key_, subkey_);
+    ::PostMessage(hwnd_, message_, valid ? TRUE : FALSE, 0);
+    return 0;
+  }
+
+private:
+  const RegistrySnapshot& snapshot_;
+  HKEY key_;
+  std::wstring subkey_;
+  HWND hwnd_;
+  UINT message_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+RegistrySnapshot::RegistrySnapshot()
+    : mapping_(nullptr),
+      view_(nullptr),
+      size_(0) {
+}
+
+RegistrySnapshot::~RegistrySnapshot() {
+  Close();
+}
+
+LSTATUS RegistrySnapshot::Export(HKEY key, const std::wstring& subkey,
+                                 const std::wstring& path) {
+  std::vector<SnapshotKeyData> keys;
+  LSTATUS status = CollectSnapshotKeys(key, subkey, std::wstring(), keys);
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  std::sort(keys.begin(), keys.end(),
+      [](const SnapshotKeyData& a, const SnapshotKeyData& b) {
+        return CompareSnapshotNames(a.path.data(), a.path.size(),
+                                    b.path.data(), b.path.size()) < 0;
+      });
+
+  size_t value_count = 0;
+  for (auto& data : keys) {
+    std::sort(data.values.begin(), data.values.end(),
+        [](const RegistryValue& a, const RegistryValue& b) {
+          return CompareSnapshotNames(a.name.data(), a.name.size(),
+                                      b.name.data(), b.name.size()) < 0;
+        });
+    value_count += data.values.size();
+  }
+
+  SnapshotHeader header = {0};
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.key_count = static_cast<DWORD>(keys.size());
+  header.value_count = static_cast<DWORD>(value_count);
+  header.keys_offset = sizeof(SnapshotHeader);
+  header.values_offset = header.keys_offset +
+                         static_cast<ULONGLONG>(header.key_count) *
+                                 sizeof(SnapshotKey);
+
+  std::vector<BYTE> file(header.values_offset +
+                         static_cast<ULONGLONG>(header.value_count) *
+                                   sizeof(SnapshotValue));
+  std::vector<SnapshotKey> key_table(keys.size());
+  std::vector<SnapshotValue> value_table;
+  value_table.reserve(value_count);
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    const auto& data = keys[i];
+    auto& entry = key_table[i];
+    entry.path_offset = AppendSnapshotData(
+        file, data.path.data(), data.path.size() * sizeof(WCHAR),
+        sizeof(WCHAR));
+    entry.path_length = static_cast<DWORD>(data.path.size());
+    entry.first_value = static_cast<DWORD>(value_table.size());
+    entry.value_count = static_cast<DWORD>(data.values.size());
+    entry.subkey_count = data.subkey_count;
+    entry.last_write_time = data.last_write_time;
+
+    for (const auto& value : data.values) {
+      SnapshotValue value_entry = {0};
+      value_entry.name_offset = AppendSnapshotData(
+          file, value.name.data(), value.name.size() * sizeof(WCHAR),
+          sizeof(WCHAR));
+      value_entry.name_length = static_cast<DWORD>(value.name.size());
+      value_entry.type = value.type;
+      value_entry.data_offset = AppendSnapshotData(
+          file, value.data.data(), value.data.size(), sizeof(ULONGLONG));
+      value_entry.data_size = static_cast<DWORD>(value.data.size());
+      value_table.push_back(value_entry);
+    }
+  }
+
+  if (!key_table.empty())
+    ::memcpy(&file[header.keys_offset], key_table.data(),
+             key_table.size() * sizeof(SnapshotKey));
+  if (!value_table.empty())
+    ::memcpy(&file[header.values_offset], value_table.data(),
+             value_table.size() * sizeof(SnapshotValue));
+
+  header.file_size = static_cast<DWORD>(file.size());
+  header.checksum = SnapshotChecksum(file.data() + sizeof(SnapshotHeader),
+                                     file.size() - sizeof(SnapshotHeader));
+  ::memcpy(&file[0], &header, sizeof(SnapshotHeader));
+
+  // Write to a temporary file first, so that readers never see a partial file
+  const std::wstring temp_path = path + L".tmp";
+  HANDLE file_handle = ::CreateFile(temp_path.c_str(), GENERIC_WRITE, 0,
+                                    nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return ::GetLastError();
+
+  {
+    Handle handle(file_handle);
+    DWORD bytes_written = 0;
+    if (!::WriteFile(handle, file.data(), header.file_size, &bytes_written,
+                     nullptr) || bytes_written != header.file_size) {
+      status = ::GetLastError();
+      if (status == ERROR_SUCCESS)
+        status = ERROR_WRITE_FAULT;
+    }
+  }
+
+  if (status == ERROR_SUCCESS &&
+      !::MoveFileEx(temp_path.c_str(), path.c_str(),
+                    MOVEFILE_REPLACE_EXISTING))
+    status = ::GetLastError();
+
+  if (status != ERROR_SUCCESS)
+    ::DeleteFile(temp_path.c_str());
+
+  return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RegistrySnapshot::Open(const std::wstring& path) {
+  Close();
+
+  HANDLE file_handle = ::CreateFile(path.c_str(), GENERIC_READ,
+                                    FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  {
+    // The mapping keeps its own reference to the file
+    Handle file(file_handle);
+
+    LARGE_INTEGER file_size = {0};
+    if (!::GetFileSizeEx(file, &file_size) ||
+        file_size.QuadPart < static_cast<LONGLONG>(sizeof(SnapshotHeader)) ||
+        file_size.QuadPart > MAXDWORD)
+      return false;
+
+    mapping_ = ::CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0,
+                                   nullptr);
+    if (!mapping_)
+      return false;
+
+    size_ = static_cast<DWORD>(file_size.QuadPart);
+  }
+
+  view_ = static_cast<const BYTE*>(
+      ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+  if (!view_ || !Verify()) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void RegistrySnapshot::Close() {
+  // Validation reads from the mapping
+  validator_.reset();
+
+  if (view_) {
+    ::UnmapViewOfFile(view_);
+    view_ = nullptr;
+  }
+  if (mapping_) {
+    ::CloseHandle(mapping_);
+    mapping_ = nullptr;
+  }
+
+  size_ = 0;
+}
+
+bool RegistrySnapshot::IsOpen() const {
+  return view_ != nullptr;
+}
+
+bool RegistrySnapshot::Verify() const {
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+
+  if (header.magic != kSnapshotMagic ||
+      header.version != kSnapshotVersion ||
+      header.file_size != size_)
+    return false;
+
+  const ULONGLONG keys_end = static_cast<ULONGLONG>(header.keys_offset) +
+                             static_cast<ULONGLONG>(header.key_count) *
+                                 sizeof(SnapshotKey);
+  const ULONGLONG values_end = static_cast<ULONGLONG>(header.values_offset) +
+                               static_cast<ULONGLONG>(header.value_count) *
+                                   sizeof(SnapshotValue);
+  if (header.keys_offset % sizeof(DWORD) || keys_end > size_ ||
+      header.values_offset % sizeof(DWORD) || values_end > size_)
+    return false;
+
+  if (header.checksum != SnapshotChecksum(view_ + sizeof(SnapshotHeader),
+                                          size_ - sizeof(SnapshotHeader)))
+    return false;
+
+  const auto in_bounds = [this](DWORD offset, ULONGLONG size,
+                                DWORD alignment) {
+    return offset % alignment == 0 &&
+           static_cast<ULONGLONG>(offset) + size <= size_;
+  };
+
+  const auto keys = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset);
+  for (DWORD i = 0; i < header.key_count; i++) {
+    if (!in_bounds(keys[i].path_offset,
+                   static_cast<ULONGLONG>(keys[i].path_length) * sizeof(WCHAR),
+                   sizeof(WCHAR)) ||
+        static_cast<ULONGLONG>(keys[i].first_value) + keys[i].value_count >
+            header.value_count)
+      return false;
+  }
+
+  const auto values = reinterpret_cast<const SnapshotValue*>(
+      view_ + header.values_offset);
+  for (DWORD i = 0; i < header.value_count; i++) {
+    if (!in_bounds(values[i].name_offset,
+                   static_cast<ULONGLONG>(values[i].name_length) *
+                       sizeof(WCHAR),
+                   sizeof(WCHAR)) ||
+        !in_bounds(values[i].data_offset, values[i].data_size, 1))
+      return false;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int RegistrySnapshot::FindKey(const std::wstring& key_path) const {
+  if (!view_)
+    return -1;
+
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+  const auto keys = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset);
+
+  const auto it = std::lower_bound(keys, keys + header.key_count, key_path,
+      [this](const SnapshotKey& key, const std::wstring& path) {
+        return CompareSnapshotNames(
+            reinterpret_cast<LPCWSTR>(view_ + key.path_offset),
+            key.path_length, path.data(), path.size()) < 0;
+      });
+
+  if (it == keys + header.key_count ||
+      CompareSnapshotNames(reinterpret_cast<LPCWSTR>(view_ + it->path_offset),
+                           it->path_length,
+                           key_path.data(), key_path.size()) != 0)
+    return -1;
+
+  return static_cast<int>(it - keys);
+}
+
+bool RegistrySnapshot::EnumKeys(const std::wstring& key_path,
+                                std::vector<std::wstring>& output) const {
+  if (FindKey(key_path) < 0)
+    return false;
+
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+  const auto keys = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset);
+  const auto last = keys + header.key_count;
+
+  // Descendants of a key share its path as a prefix, and are therefore
+  // adjacent in sorted order.
+  const std::wstring prefix = key_path.empty() ? key_path : key_path + L"\\";
+  auto it = std::lower_bound(keys, last, prefix,
+      [this](const SnapshotKey& key, const std::wstring& path) {
+        return CompareSnapshotNames(
+            reinterpret_cast<LPCWSTR>(view_ + key.path_offset),
+            key.path_length, path.data(), path.size()) < 0;
+      });
+
+  for (; it != last; ++it) {
+    const auto path = reinterpret_cast<LPCWSTR>(view_ + it->path_offset);
+    const size_t path_length = it->path_length;
+    if (path_length < prefix.size() ||
+        CompareSnapshotNames(path, prefix.size(),
+                             prefix.data(), prefix.size()) != 0)
+      break;
+    if (path_length == prefix.size())
+      continue;
+    if (std::find(path + prefix.size(), path + path_length, L'\\') ==
+        path + path_length)
+      output.emplace_back(path + prefix.size(), path_length - prefix.size());
+  }
+
+  return true;
+}
+
+bool RegistrySnapshot::EnumValues(const std::wstring& key_path,
+                                  std::vector<Value>& output) const {
+  const int index = FindKey(key_path);
+  if (index < 0)
+    return false;
+
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+  const auto& key = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset)[index];
+  const auto values = reinterpret_cast<const SnapshotValue*>(
+      view_ + header.values_offset);
+
+  output.reserve(output.size() + key.value_count);
+
+  for (DWORD i = key.first_value; i < key.first_value + key.value_count; i++) {
+    Value value;
+    value.name = reinterpret_cast<LPCWSTR>(view_ + values[i].name_offset);
+    value.name_length = values[i].name_length;
+    value.type = values[i].type;
+    value.data = view_ + values[i].data_offset;
+    value.data_size = values[i].data_size;
+    output.push_back(value);
+  }
+
+  return true;
+}
+
+bool RegistrySnapshot::QueryValue(const std::wstring& key_path,
+                                  const std::wstring& value_name,
+                                  Value& output) const {
+  const int index = FindKey(key_path);
+  if (index < 0)
+    return false;
+
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+  const auto& key = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset)[index];
+  const auto values = reinterpret_cast<const SnapshotValue*>(
+      view_ + header.values_offset);
+
+  const auto first = values + key.first_value;
+  const auto last = first + key.value_count;
+  const auto it = std::lower_bound(first, last, value_name,
+      [this](const SnapshotValue& value, const std::wstring& name) {
+        return CompareSnapshotNames(
+            reinterpret_cast<LPCWSTR>(view_ + value.name_offset),
+            value.name_length, name.data(), name.size()) < 0;
+      });
+
+  if (it == last ||
+      CompareSnapshotNames(reinterpret_cast<LPCWSTR>(view_ + it->name_offset),
+                           it->name_length,
+                           value_name.data(), value_name.size()) != 0)
+    return false;
+
+  output.name = reinterpret_cast<LPCWSTR>(view_ + it->name_offset);
+  output.name_length = it->name_length;
+  output.type = it->type;
+  output.data = view_ + it->data_offset;
+  output.data_size = it->data_size;
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool RegistrySnapshot::Validate(HKEY key, const std::wstring& subkey) const {
+  // Any change to the values of a key updates its last write time, and added
+  // or removed subkeys change the subkey count of their parent, so comparing
+  // key information is enough to detect a stale snapshot.
+
+  if (!view_)
+    return false;
+
+  const auto& header = *reinterpret_cast<const SnapshotHeader*>(view_);
+  const auto keys = reinterpret_cast<const SnapshotKey*>(
+      view_ + header.keys_offset);
+
+  for (DWORD i = 0; i < header.key_count; i++) {
+    const std::wstring path(
+        reinterpret_cast<LPCWSTR>(view_ + keys[i].path_offset),
+        keys[i].path_length);
+
+    Registry registry;
+    if (registry.OpenKey(key, GetSnapshotKeyPath(subkey, path), 0,
+                         KEY_QUERY_VALUE) != ERROR_SUCCESS)
+      return false;
+
+    SnapshotKeyData data;
+    if (QuerySnapshotKeyInfo(registry.GetHandle(), data) != ERROR_SUCCESS ||
+        data.subkey_count != keys[i].subkey_count ||
+        data.value_count != keys[i].value_count ||
+        ::CompareFileTime(&data.last_write_time,
+                          &keys[i].last_write_time) != 0)
+      return false;
+  }
+
+  return true;
+}
+
+bool RegistrySnapshot::ValidateAsync(HKEY key, const std::wstring& subkey,
+                                     HWND hwnd, UINT message) {
+  // The result is posted as the wParam of the message
+  if (!view_)
+    return false;
+
+  validator_.reset(new SnapshotValidator(*this, key, subkey, hwnd, message));
+
+  return validator_->CreateThread(nullptr, 0, 0);
+}
+
+}  // namespace win
@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+namespace win {
+
+class SnapshotValidator;
+
+// A read-only, memory-mapped copy of a registry subtree. Values are read in
+// place from the mapping, and can be checked against the live registry from a
+// background thread after they have been used.
+
+class RegistrySnapshot {
+public:
+  struct Value {
+    LPCWSTR name = nullptr;
+    DWORD name_length = 0;
+    DWORD type = REG_NONE;
+    const BYTE* data = nullptr;
+    DWORD data_size = 0;
+  };
+
+  RegistrySnapshot();
+  ~RegistrySnapshot();
+
+  static LSTATUS Export(HKEY key, const std::wstring& subkey, const std::wstring& path);
+
+  bool Open(const std::wstring& path);
+  void Close();
+  bool IsOpen() const;
+
+  // Key paths are relative to the exported subkey, an empty path being the
+  // subkey itself. Names are compared case-insensitively, as in the registry.
+  bool EnumKeys(const std::wstring& key_path, std::vector<std::wstring>& output) const;
+  bool EnumValues(const std::wstring& key_path, std::vector<Value>& output) const;
+  bool QueryValue(const std::wstring& key_path, const std::wstring& value_name, Value& output) const;
+
+  bool Validate(HKEY key, const std::wstring& subkey) const;
+  bool ValidateAsync(HKEY key, const std::wstring& subkey, HWND hwnd, UINT message);
+
+private:
+  int FindKey(const std::wstring& key_path) const;
+  bool Verify() const;
+
+  HANDLE mapping_;
+  const BYTE* view_;
+  DWORD size_;
+
+  std::unique_ptr<SnapshotValidator> validator_;
+};
+
+}  // namespace win
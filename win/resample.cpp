@@ -0,0 +1,568 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "raster.h"
+#include "resample.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIN_RESAMPLE_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define WIN_RESAMPLE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define WIN_TARGET_AVX2
+#else
+#define WIN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+namespace win {
+
+// Weights are 2.14 fixed-point numbers, so that two products of a channel
+// and a weight can be summed in 32 bits with a single multiply-add.
+const int kWeightBits = 14;
+const int kWeightRound = 1 << (kWeightBits - 1);
+
+// Each output pixel reads the same number of taps, starting from a position
+// that keeps every tap inside the source. Unused taps have zero weight.
+struct ResampleWeights {
+  int taps;
+  std::vector<int> starts;
+  std::vector<int16_t> values;
+
+  const int16_t* Get(int i) const { return &values[i * taps]; }
+};
+
+const double kPi = 3.14159265358979323846;
+
+double Sinc(double x) {
+  if (x == 0.0)
+    return 1.0;
+  x *= kPi;
+  return std::sin(x) / x;
+}
+
+double FilterSupport(ResampleFilter filter) {
+  switch (filter) {
+    case kResampleBox:
+      return 0.5;
+    case kResampleBilinear:
+      return 1.0;
+    case kResampleLanczos:
+    default:
+      return 3.0;
+  }
+}
+
+double FilterWeight(ResampleFilter filter, double x) {
+  switch (filter) {
+    case kResampleBox:
+      return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+    case kResampleBilinear:
+      x = std::fabs(x);
+      return x < 1.0 ? 1.0 - x : 0.0;
+    case kResampleLanczos:
+    default:
+      return std::fabs(x) < 3.0 ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+  }
+}
+
+void ComputeWeights(ResampleFilter filter, int src_size, int dst_size,
+                    ResampleWeights& weights) {
+  const double scale = static_cast<double>(src_size) / dst_size;
+  // When downscaling, the filter is stretched to cover every source pixel
+  const double filter_scale = scale > 1.0 ? scale : 1.0;
+  const double support = FilterSupport(filter) * filter_scale;
+
+  int taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+  if (taps > src_size)
+    taps = src_size;
+
+  weights.taps = taps;
+  weights.starts.assign(dst_size, 0);
+  weights.values.assign(static_cast<size_t>(dst_size) * taps, 0);
+
+  std::vector<double> values(taps);
+
+  for (int i = 0; i < dst_size; ++i) {
+    const double center = (i + 0.5) * scale;
+    int left = static_cast<int>(std::floor(center - support));
+    int right = static_cast<int>(std::ceil(center + support));
+    if (left < 0)
+      left = 0;
+    if (right > src_size)
+      right = src_size;
+    if (right - left > taps)
+      right = left + taps;
+
+    double total = 0.0;
+    for (int j = left; j < right; ++j) {
+      values[j - left] =
+          FilterWeight(filter, (j + 0.5 - center) / filter_scale);
+      total += values[j - left];
+    }
+    // The box filter can miss every pixel when upscaling
+    if (total == 0.0) {
+      const int nearest = static_cast<int>(center);
+      left = nearest < src_size ? nearest : src_size - 1;
+      right = left + 1;
+      values[0] = total = 1.0;
+    }
+
+    int start = left;
+    if (start > src_size - taps)
+      start = src_size - taps;
+    weights.starts[i] = start;
+
+    int16_t* fixed = &weights.values[static_cast<size_t>(i) * taps];
+    int sum = 0;
+    int largest = left - start;
+    for (int j = left; j < right; ++j) {
+      const double value = values[j - left] / total;
+      fixed[j - start] = static_cast<int16_t>(
+          std::floor(value * (1 << kWeightBits) + 0.5));
+      sum += fixed[j - start];
+      if (fixed[j - start] > fixed[largest])
+        largest = j - start;
+    }
+    // Rounding errors go to the largest weight, so that a flat area keeps
+    // its exact color.
+    fixed[largest] += static_cast<int16_t>((1 << kWeightBits) - sum);
+  }
+}
+
+inline int ClampChannel(int value) {
+  value = (value + kWeightRound) >> kWeightBits;
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Filters with negative lobes can leave a color above its alpha
+inline uint32_t PackPixel(const int sums[4]) {
+  const int alpha = ClampChannel(sums[3]);
+  uint32_t pixel = static_cast<uint32_t>(alpha) << 24;
+  for (int c = 0; c < 3; ++c) {
+    const int value = ClampChannel(sums[c]);
+    pixel |= static_cast<uint32_t>(value < alpha ? value : alpha) << (c * 8);
+  }
+  return pixel;
+}
+
+inline const uint32_t* OffsetRow(const uint32_t* row, ptrdiff_t stride) {
+  return reinterpret_cast<const uint32_t*>(
+      reinterpret_cast<const uint8_t*>(row) + stride);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar
+
+void HorizontalPixelsScalar(uint32_t* dst, const uint32_t* src,
+                            const ResampleWeights& weights,
+                            int begin, int end) {
+  for (int x = begin; x < end; ++x) {
+    const uint32_t* pixels = src + weights.starts[x];
+    const int16_t* values = weights.Get(x);
+    int sums[4] = {0};
+    for (int k = 0; k < weights.taps; ++k) {
+      for (int c = 0; c < 4; ++c)
+        sums[c] += ((pixels[k] >> (c * 8)) & 0xFF) * values[k];
+    }
+    dst[x] = PackPixel(sums);
+  }
+}
+
+void HorizontalRowScalar(uint32_t* dst, const uint32_t* src,
+                         const ResampleWeights& weights, int width) {
+  HorizontalPixelsScalar(dst, src, weights, 0, width);
+}
+
+void VerticalPixelsScalar(uint32_t* dst, const uint32_t* src,
+                          ptrdiff_t src_stride, const int16_t* values,
+                          int taps, int begin, int end) {
+  for (int x = begin; x < end; ++x) {
+    const uint32_t* row = src;
+    int sums[4] = {0};
+    for (int k = 0; k < taps; ++k, row = OffsetRow(row, src_stride)) {
+      for (int c = 0; c < 4; ++c)
+        sums[c] += ((row[x] >> (c * 8)) & 0xFF) * values[k];
+    }
+    dst[x] = PackPixel(sums);
+  }
+}
+
+void VerticalRowScalar(uint32_t* dst, const uint32_t* src,
+                       ptrdiff_t src_stride, const int16_t* values,
+                       int taps, int width) {
+  VerticalPixelsScalar(dst, src, src_stride, values, taps, 0, width);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE2
+
+#ifdef WIN_RESAMPLE_SSE2
+
+inline __m128i PairWeights(int16_t first, int16_t second) {
+  return _mm_set1_epi32(static_cast<uint16_t>(first) |
+                        (static_cast<uint32_t>(second) << 16));
+}
+
+// Rounds, packs and clamps four pixels of 32-bit channel sums
+inline __m128i PackPixelsSse2(__m128i s0, __m128i s1, __m128i s2, __m128i s3) {
+  const __m128i round = _mm_set1_epi32(kWeightRound);
+  s0 = _mm_srai_epi32(_mm_add_epi32(s0, round), kWeightBits);
+  s1 = _mm_srai_epi32(_mm_add_epi32(s1, round), kWeightBits);
+  s2 = _mm_srai_epi32(_mm_add_epi32(s2, round), kWeightBits);
+  s3 = _mm_srai_epi32(_mm_add_epi32(s3, round), kWeightBits);
+  const __m128i pixels = _mm_packus_epi16(_mm_packs_epi32(s0, s1),
+                                          _mm_packs_epi32(s2, s3));
+
+  __m128i alpha = _mm_srli_epi32(pixels, 24);
+  alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+  alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+  return _mm_min_epu8(pixels, alpha);
+}
+
+// Sums the channels of one pixel over its taps. Two taps are interleaved
+// at a time, so that they can be multiplied and added together.
+inline __m128i HorizontalSumSse2(const uint32_t* pixels, const int16_t* values,
+                                 int begin, int taps, __m128i sum) {
+  const __m128i zero = _mm_setzero_si128();
+
+  int k = begin;
+  for (; k + 2 <= taps; k += 2) {
+    const __m128i p0 = _mm_cvtsi32_si128(static_cast<int>(pixels[k]));
+    const __m128i p1 = _mm_cvtsi32_si128(static_cast<int>(pixels[k + 1]));
+    const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(p, PairWeights(values[k],
+                                                           values[k + 1])));
+  }
+  if (k < taps) {
+    const __m128i p0 = _mm_cvtsi32_si128(static_cast<int>(pixels[k]));
+    const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, zero), zero);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(p, PairWeights(values[k], 0)));
+  }
+
+  return sum;
+}
+
+void HorizontalRowSse2(uint32_t* dst, const uint32_t* src,
+                       const ResampleWeights& weights, int width) {
+  const __m128i zero = _mm_setzero_si128();
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i sums[4];
+    for (int i = 0; i < 4; ++i) {
+      sums[i] = HorizontalSumSse2(src + weights.starts[x + i],
+                                  weights.Get(x + i), 0, weights.taps, zero);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     PackPixelsSse2(sums[0], sums[1], sums[2], sums[3]));
+  }
+
+  HorizontalPixelsScalar(dst, src, weights, x, width);
+}
+
+// Sums four pixels of a row pair. Bytes of the two rows are interleaved, so
+// that each channel is next to the same channel of the other row.
+inline void VerticalSumSse2(__m128i r0, __m128i r1, __m128i weights,
+                            __m128i sums[4]) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = _mm_unpacklo_epi8(r0, r1);
+  const __m128i hi = _mm_unpackhi_epi8(r0, r1);
+  sums[0] = _mm_add_epi32(sums[0],
+      _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weights));
+  sums[1] = _mm_add_epi32(sums[1],
+      _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weights));
+  sums[2] = _mm_add_epi32(sums[2],
+      _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weights));
+  sums[3] = _mm_add_epi32(sums[3],
+      _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weights));
+}
+
+void VerticalRowSse2(uint32_t* dst, const uint32_t* src,
+                     ptrdiff_t src_stride, const int16_t* values,
+                     int taps, int width) {
+  const __m128i zero = _mm_setzero_si128();
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i sums[4] = {zero, zero, zero, zero};
+    const uint32_t* row = src + x;
+
+    int k = 0;
+    for (; k + 2 <= taps; k += 2) {
+      const uint32_t* next = OffsetRow(row, src_stride);
+      VerticalSumSse2(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(next)),
+          PairWeights(values[k], values[k + 1]), sums);
+      row = OffsetRow(next, src_stride);
+    }
+    if (k < taps) {
+      VerticalSumSse2(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row)), zero,
+          PairWeights(values[k], 0), sums);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     PackPixelsSse2(sums[0], sums[1], sums[2], sums[3]));
+  }
+
+  VerticalPixelsScalar(dst, src, src_stride, values, taps, x, width);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2
+
+#ifdef WIN_RESAMPLE_AVX2
+
+// Four taps are summed at a time, two in each 128-bit lane.
+WIN_TARGET_AVX2
+void HorizontalRowAvx2(uint32_t* dst, const uint32_t* src,
+                       const ResampleWeights& weights, int width) {
+  const __m128i order = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7,
+                                      8, 12, 9, 13, 10, 14, 11, 15);
+  const int taps = weights.taps;
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i sums[4];
+    for (int i = 0; i < 4; ++i) {
+      const uint32_t* pixels = src + weights.starts[x + i];
+      const int16_t* values = weights.Get(x + i);
+      __m256i sum = _mm256_setzero_si256();
+
+      int k = 0;
+      for (; k + 4 <= taps; k += 4) {
+        const __m128i p = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k)),
+            order);
+        const int w01 = static_cast<uint16_t>(values[k]) |
+                        (static_cast<uint32_t>(values[k + 1]) << 16);
+        const int w23 = static_cast<uint16_t>(values[k + 2]) |
+                        (static_cast<uint32_t>(values[k + 3]) << 16);
+        const __m256i w = _mm256_setr_epi32(w01, w01, w01, w01,
+                                            w23, w23, w23, w23);
+        sum = _mm256_add_epi32(sum,
+                               _mm256_madd_epi16(_mm256_cvtepu8_epi16(p), w));
+      }
+
+      const __m128i lanes = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                          _mm256_extracti128_si256(sum, 1));
+      sums[i] = HorizontalSumSse2(pixels, values, k, taps, lanes);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                     PackPixelsSse2(sums[0], sums[1], sums[2], sums[3]));
+  }
+
+  HorizontalPixelsScalar(dst, src, weights, x, width);
+}
+
+// Unpacking and packing both work within 128-bit lanes, so the pixels end up
+// in their original order.
+WIN_TARGET_AVX2
+void VerticalRowAvx2(uint32_t* dst, const uint32_t* src,
+                     ptrdiff_t src_stride, const int16_t* values,
+                     int taps, int width) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i round = _mm256_set1_epi32(kWeightRound);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+    const uint32_t* row = src + x;
+
+    for (int k = 0; k < taps; k += 2) {
+      const __m256i r0 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+      __m256i r1 = zero;
+      int16_t second = 0;
+      row = OffsetRow(row, src_stride);
+      if (k + 1 < taps) {
+        r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+        second = values[k + 1];
+        row = OffsetRow(row, src_stride);
+      }
+      const __m256i w = _mm256_set1_epi32(
+          static_cast<uint16_t>(values[k]) |
+          (static_cast<uint32_t>(second) << 16));
+
+      const __m256i lo = _mm256_unpacklo_epi8(r0, r1);
+      const __m256i hi = _mm256_unpackhi_epi8(r0, r1);
+      s0 = _mm256_add_epi32(s0,
+          _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+      s1 = _mm256_add_epi32(s1,
+          _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+      s2 = _mm256_add_epi32(s2,
+          _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+      s3 = _mm256_add_epi32(s3,
+          _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+    }
+
+    s0 = _mm256_srai_epi32(_mm256_add_epi32(s0, round), kWeightBits);
+    s1 = _mm256_srai_epi32(_mm256_add_epi32(s1, round), kWeightBits);
+    s2 = _mm256_srai_epi32(_mm256_add_epi32(s2, round), kWeightBits);
+    s3 = _mm256_srai_epi32(_mm256_add_epi32(s3, round), kWeightBits);
+    const __m256i pixels = _mm256_packus_epi16(_mm256_packs_epi32(s0, s1),
+                                               _mm256_packs_epi32(s2, s3));
+
+    __m256i alpha = _mm256_srli_epi32(pixels, 24);
+    alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 8));
+    alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                        _mm256_min_epu8(pixels, alpha));
+  }
+
+  VerticalRowSse2(dst + x, src + x, src_stride, values, taps, width - x);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+typedef void (*HorizontalRowFunction)(uint32_t*, const uint32_t*,
+                                      const ResampleWeights&, int);
+typedef void (*VerticalRowFunction)(uint32_t*, const uint32_t*, ptrdiff_t,
+                                    const int16_t*, int, int);
+
+// Calls the function for bands of rows, on separate threads if there is more
+// than one band.
+template <typename Function>
+void ForEachBand(int rows, int bands, Function function) {
+  if (bands > rows)
+    bands = rows;
+  if (bands <= 1) {
+    function(0, rows);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(bands - 1);
+  for (int i = 1; i < bands; ++i) {
+    const int begin = static_cast<int>(static_cast<int64_t>(rows) * i / bands);
+    const int end =
+        static_cast<int>(static_cast<int64_t>(rows) * (i + 1) / bands);
+    threads.emplace_back(function, begin, end);
+  }
+  function(0, rows / bands);
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+// Work is counted in taps, i.e. one channel sum per tap and pixel
+int GetBandCount(int64_t work, int threads) {
+  // Smaller images are not worth the cost of starting threads
+  const int64_t kWorkPerBand = 4 * 1024 * 1024;
+
+  if (threads > 0)
+    return threads;
+
+  int count = static_cast<int>(work / kWorkPerBand);
+  const int processors = static_cast<int>(std::thread::hardware_concurrency());
+  if (count > processors)
+    count = processors;
+  return count > 1 ? count : 1;
+}
+
+bool ResamplePixels(uint32_t* dst, ptrdiff_t dst_stride,
+                    int dst_width, int dst_height,
+                    const uint32_t* src, ptrdiff_t src_stride,
+                    int src_width, int src_height,
+                    ResampleFilter filter, int threads) {
+  if (!dst || !src || dst_width <= 0 || dst_height <= 0 ||
+      src_width <= 0 || src_height <= 0)
+    return false;
+
+  if (dst_width == src_width && dst_height == src_height) {
+    CopyPixels(dst, dst_stride, src, src_stride, src_width, src_height);
+    return true;
+  }
+
+  HorizontalRowFunction horizontal_row = HorizontalRowScalar;
+  VerticalRowFunction vertical_row = VerticalRowScalar;
+#ifdef WIN_RESAMPLE_SSE2
+  if (GetRasterLevel() >= kRasterSse2) {
+    horizontal_row = HorizontalRowSse2;
+    vertical_row = VerticalRowSse2;
+  }
+#endif
+#ifdef WIN_RESAMPLE_AVX2
+  if (GetRasterLevel() >= kRasterAvx2) {
+    horizontal_row = HorizontalRowAvx2;
+    vertical_row = VerticalRowAvx2;
+  }
+#endif
+
+  ResampleWeights horizontal_weights;
+  ResampleWeights vertical_weights;
+  ComputeWeights(filter, src_width, dst_width, horizontal_weights);
+  ComputeWeights(filter, src_height, dst_height, vertical_weights);
+
+  // The horizontal pass only needs the rows that the vertical pass reads
+  const int first_row = vertical_weights.starts.front();
+  const int last_row = vertical_weights.starts.back() + vertical_weights.taps;
+  const int rows = last_row - first_row;
+
+  std::vector<uint32_t> buffer(static_cast<size_t>(dst_width) * rows);
+  const ptrdiff_t buffer_stride = dst_width * sizeof(uint32_t);
+
+  const int64_t horizontal_work =
+      static_cast<int64_t>(dst_width) * rows * horizontal_weights.taps;
+  ForEachBand(rows, GetBandCount(horizontal_work, threads),
+      [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+          horizontal_row(&buffer[static_cast<size_t>(y) * dst_width],
+                         OffsetRow(src, (first_row + y) * src_stride),
+                         horizontal_weights, dst_width);
+        }
+      });
+
+  const int64_t vertical_work =
+      static_cast<int64_t>(dst_width) * dst_height * vertical_weights.taps;
+  ForEachBand(dst_height, GetBandCount(vertical_work, threads),
+      [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+          const int start = vertical_weights.starts[y] - first_row;
+          vertical_row(reinterpret_cast<uint32_t*>(
+                           reinterpret_cast<uint8_t*>(dst) + y * dst_stride),
+                       &buffer[static_cast<size_t>(start) * dst_width],
+                       buffer_stride, vertical_weights.Get(y),
+                       vertical_weights.taps, dst_width);
+        }
+      });
+
+  return true;
+}
+
+}  // namespace win
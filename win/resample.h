@@ -0,0 +1,52 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace win {
+
+// Separable image resampling for 32-bit premultiplied ARGB pixels, using
+// fixed-point weights and SSE2 or AVX2 where available (see raster.h). The
+// code does not depend on Windows.
+
+enum ResampleFilter {
+  kResampleBox,
+  kResampleBilinear,
+  kResampleLanczos
+};
+
+// Scales the source pixels to fill the destination. Large images are split
+// into bands of rows, which are processed on the given number of threads.
+// Zero threads selects a count based on the image size and the processor.
+bool ResamplePixels(uint32_t* dst, ptrdiff_t dst_stride,
+                    int dst_width, int dst_height,
+                    const uint32_t* src, ptrdiff_t src_stride,
+                    int src_width, int src_height,
+                    ResampleFilter filter = kResampleLanczos,
+                    int threads = 0);
+
+}  // namespace win
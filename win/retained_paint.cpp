@@ -0,0 +1,75 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <utility>
+
+#include "retained_paint.h"
+
+namespace win {
+
+RetainedPaintCache::RetainedPaintCache(size_t max_bytes)
+    : entries_(max_bytes, [](const HWND&, Entry& entry) {
+        if (entry.bitmap)
+          ::DeleteObject(entry.bitmap);
+      }) {
+}
+
+RetainedPaintCache::Entry* RetainedPaintCache::Get(HWND hwnd) {
+  return entries_.Get(hwnd);
+}
+
+RetainedPaintCache::Entry* RetainedPaintCache::Peek(HWND hwnd) {
+  return entries_.Peek(hwnd);
+}
+
+RetainedPaintCache::Entry& RetainedPaintCache::Put(HWND hwnd, HBITMAP bitmap,
+                                                   const SIZE& size,
+                                                   UINT version) {
+  Entry entry;
+  entry.bitmap = bitmap;
+  entry.size = size;
+  entry.version = version;
+
+  const size_t bytes = static_cast<size_t>(size.cx) * size.cy * 4;
+  return entries_.Put(hwnd, std::move(entry), bytes);
+}
+
+void RetainedPaintCache::Remove(HWND hwnd) {
+  entries_.Erase(hwnd);
+}
+
+void RetainedPaintCache::Clear() {
+  entries_.Clear();
+}
+
+void RetainedPaintCache::SetBudget(size_t max_bytes) {
+  entries_.SetCapacity(max_bytes);
+}
+
+RetainedPaintCache& GetRetainedPaintCache() {
+  thread_local RetainedPaintCache retained_paint_cache;
+  return retained_paint_cache;
+}
+
+}  // namespace win
@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include <windows.h>
+
+#include "geometry.h"
+#include "lru_cache.h"
+
+namespace win {
+
+// Keeps the last rendered content of windows in retained paint mode, within a
+// byte budget shared by all windows of a thread.
+
+class RetainedPaintCache {
+public:
+  struct Entry {
+    HBITMAP bitmap = nullptr;
+    SIZE size = {0, 0};
+    UINT version = 0;
+    // Parts of the bitmap that must be rendered again
+    DirtyRegion stale;
+  };
+
+  RetainedPaintCache(size_t max_bytes = 64 * 1024 * 1024);
+
+  Entry* Get(HWND hwnd);
+  Entry* Peek(HWND hwnd);
+  // The cache takes ownership of the bitmap
+  Entry& Put(HWND hwnd, HBITMAP bitmap, const SIZE& size, UINT version);
+  void Remove(HWND hwnd);
+
+  void Clear();
+  void SetBudget(size_t max_bytes);
+
+private:
+  LruCache<HWND, Entry> entries_;
+};
+
+RetainedPaintCache& GetRetainedPaintCache();
+
+}  // namespace win
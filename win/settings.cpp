@@ -0,0 +1,242 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "registry.h"
+#include "settings.h"
+
+namespace win {
+
+// Changes keep postponing the write-back until no further changes arrive, but
+// never for longer than this many debounce intervals.
+const DWORD kSettingsMaxDelayFactor = 4;
+
+SettingsStore::SettingsStore()
+    : key_(nullptr),
+      debounce_interval_(0) {
+  change_event_.Create(nullptr, FALSE, FALSE, nullptr);
+  stop_event_.Create(nullptr, TRUE, FALSE, nullptr);
+}
+
+SettingsStore::~SettingsStore() {
+  Stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+LSTATUS SettingsStore::Load(HKEY key, const std::wstring& subkey) {
+  {
+    Lock lock(critical_section_);
+    key_ = key;
+    subkey_ = subkey;
+  }
+
+  Registry registry;
+  LSTATUS status = registry.OpenKey(key, subkey, 0, KEY_QUERY_VALUE);
+  if (status == ERROR_FILE_NOT_FOUND)
+    return ERROR_SUCCESS;
+  if (status != ERROR_SUCCESS)
+    return status;
+
+  std::vector<RegistryValue> values;
+  status = registry.EnumValues(values);
+
+  Lock lock(critical_section_);
+  for (auto& it : values) {
+    auto& value = values_[it.name];
+    if (!value.dirty) {
+      value.type = it.type;
+      value.data.swap(it.data);
+    }
+  }
+
+  return status;
+}
+
+bool SettingsStore::Start(DWORD debounce_interval) {
+  if (GetThreadHandle())
+    return true;
+
+  debounce_interval_ = debounce_interval;
+  stop_event_.Reset();
+
+  return CreateThread(nullptr, 0, 0);
+}
+
+void SettingsStore::Stop() {
+  if (GetThreadHandle()) {
+    stop_event_.Set();
+    ::WaitForSingleObject(GetThreadHandle(), INFINITE);
+    CloseThreadHandle();
+  }
+
+  Flush();
+}
+
+LSTATUS SettingsStore::Flush() {
+  // Serializes flushes, so that an older batch can never overwrite a newer one
+  Lock flush_lock(flush_section_);
+
+  HKEY key = nullptr;
+  std::wstring subkey;
+  RegistryBatch batch;
+  std::vector<std::wstring> names;
+
+  {
+    Lock lock(critical_section_);
+    if (!key_)
+      return ERROR_INVALID_HANDLE;
+    key = key_;
+    subkey = subkey_;
+
+    for (auto& it : values_) {
+      auto& value = it.second;
+      if (value.dirty) {
+        batch.SetValue(std::wstring(), it.first, value.type,
+                       value.data.empty() ? nullptr : value.data.data(),
+                       static_cast<DWORD>(value.data.size()));
+        names.push_back(it.first);
+        value.dirty = false;
+      }
+    }
+  }
+
+  if (batch.IsEmpty())
+    return ERROR_SUCCESS;
+
+  LSTATUS status = batch.Commit(key, subkey);
+
+  if (status != ERROR_SUCCESS) {
+    Lock lock(critical_section_);
+    for (const auto& name : names)
+      values_[name].dirty = true;
+  }
+
+  return status;
+}
+
+bool SettingsStore::IsDirty() const {
+  Lock lock(critical_section_);
+
+  for (const auto& it : values_)
+    if (it.second.dirty)
+      return true;
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SettingsStore::GetValue(const std::wstring& name, DWORD& output) const {
+  std::vector<BYTE> data;
+  if (!GetValue(name, REG_DWORD, data) || data.size() != sizeof(DWORD))
+    return false;
+
+  output = *reinterpret_cast<const DWORD*>(data.data());
+  return true;
+}
+
+bool SettingsStore::GetValue(const std::wstring& name,
+                             std::wstring& output) const {
+  std::vector<BYTE> data;
+  if (!GetValue(name, REG_SZ, data) && !GetValue(name, REG_EXPAND_SZ, data))
+    return false;
+
+  output.assign(reinterpret_cast<const WCHAR*>(data.data()),
+                data.size() / sizeof(WCHAR));
+  while (!output.empty() && output.back() == L'\0')
+    output.pop_back();
+
+  return true;
+}
+
+bool SettingsStore::GetValue(const std::wstring& name,
+                             std::vector<BYTE>& output) const {
+  return GetValue(name, REG_BINARY, output);
+}
+
+bool SettingsStore::GetValue(const std::wstring& name, DWORD type,
+                             std::vector<BYTE>& output) const {
+  Lock lock(critical_section_);
+
+  auto it = values_.find(name);
+  if (it == values_.end() || it->second.type != type)
+    return false;
+
+  output = it->second.data;
+  return true;
+}
+
+void SettingsStore::SetValue(const std::wstring& name, DWORD value) {
+  SetValue(name, REG_DWORD, reinterpret_cast<CONST BYTE*>(&value),
+           sizeof(value));
+}
+
+void SettingsStore::SetValue(const std::wstring& name,
+                             const std::wstring& value) {
+  SetValue(name, REG_SZ, reinterpret_cast<CONST BYTE*>(value.c_str()),
+           static_cast<DWORD>((value.size() + 1) * sizeof(WCHAR)));
+}
+
+void SettingsStore::SetValue(const std::wstring& name, DWORD type,
+                             CONST BYTE* data, DWORD data_size) {
+  {
+    Lock lock(critical_section_);
+
+    auto& value = values_[name];
+    if (value.type == type && value.data.size() == data_size &&
+        (!data_size || ::memcmp(value.data.data(), data, data_size) == 0))
+      return;
+
+    value.type = type;
+    value.data.assign(data, data + data_size);
+    value.dirty = true;
+  }
+
+  change_event_.Set();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DWORD SettingsStore::ThreadProc() {
+  const HANDLE events[] = {stop_event_.Get(), change_event_.Get()};
+  const DWORD kChanged = WAIT_OBJECT_0 + 1;
+
+  while (::WaitForMultipleObjects(2, events, FALSE, INFINITE) == kChanged) {
+    const DWORD start = ::GetTickCount();
+    while (::WaitForMultipleObjects(2, events, FALSE,
+                                    debounce_interval_) == kChanged) {
+      if (::GetTickCount() - start >=
+          debounce_interval_ * kSettingsMaxDelayFactor)
+        break;
+    }
+
+    Flush();
+  }
+
+  return 0;
+}
+
+}  // namespace win
@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+#include "thread.h"
+
+namespace win {
+
+// Keeps settings of a registry key in memory. Changed values are written back
+// from a background thread once no further changes have been made during the
+// debounce interval, so that rapid updates are coalesced into a single batch.
+// Pending changes are also written on Flush, Stop and destruction. Register
+// Stop with App::AddExitHandler, so that nothing is lost when the application
+// exits.
+
+class SettingsStore : public Thread {
+public:
+  SettingsStore();
+  ~SettingsStore();
+
+  LSTATUS Load(HKEY key, const std::wstring& subkey);
+  bool Start(DWORD debounce_interval = 500);
+  void Stop();
+  LSTATUS Flush();
+  bool IsDirty() const;
+
+  bool GetValue(const std::wstring& name, DWORD& output) const;
+  bool GetValue(const std::wstring& name, std::wstring& output) const;
+  bool GetValue(const std::wstring& name, std::vector<BYTE>& output) const;
+  void SetValue(const std::wstring& name, DWORD value);
+  void SetValue(const std::wstring& name, const std::wstring& value);
+  void SetValue(const std::wstring& name, DWORD type, CONST BYTE* data, DWORD data_size);
+
+  DWORD ThreadProc();
+
+private:
+  struct Value {
+    DWORD type = REG_NONE;
+    std::vector<BYTE> data;
+    bool dirty = false;
+  };
+
+  bool GetValue(const std::wstring& name, DWORD type, std::vector<BYTE>& output) const;
+
+  HKEY key_;
+  std::wstring subkey_;
+  DWORD debounce_interval_;
+  std::map<std::wstring, Value> values_;
+
+  mutable CriticalSection critical_section_;
+  CriticalSection flush_section_;
+  Event change_event_;
+  Event stop_event_;
+};
+
+}  // namespace win
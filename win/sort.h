@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace win {
+
+template <typename Function>
+void RunTasks(int count, Function function) {
+  std::vector<std::thread> threads;
+  threads.reserve(count > 1 ? count - 1 : 0);
+  for (int i = 1; i < count; ++i)
+    threads.emplace_back(function, i);
+  if (count > 0)
+    function(0);
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+// A stable merge sort that sorts blocks of the range in parallel, and then
+// merges neighboring blocks until a single one is left. Elements that compare
+// equal keep their relative order. Smaller ranges are sorted on the calling
+// thread.
+template <typename RandomIt, typename Compare>
+void ParallelStableSort(RandomIt first, RandomIt last, Compare compare,
+                        int threads = 0) {
+  const ptrdiff_t kMinBlockSize = 8 * 1024;
+
+  const ptrdiff_t size = last - first;
+  ptrdiff_t blocks = threads;
+  if (blocks <= 0) {
+    blocks = static_cast<ptrdiff_t>(std::thread::hardware_concurrency());
+    if (blocks > size / kMinBlockSize)
+      blocks = size / kMinBlockSize;
+  }
+  if (blocks > size)
+    blocks = size;
+
+  if (blocks <= 1) {
+    std::stable_sort(first, last, compare);
+    return;
+  }
+
+  std::vector<ptrdiff_t> bounds(blocks + 1);
+  for (ptrdiff_t i = 0; i <= blocks; ++i)
+    bounds[i] = size * i / blocks;
+
+  RunTasks(static_cast<int>(blocks), [&](int i) {
+    std::stable_sort(first + bounds[i], first + bounds[i + 1], compare);
+  });
+
+  for (ptrdiff_t width = 1; width < blocks; width *= 2) {
+    const ptrdiff_t merges = (blocks - width + 2 * width - 1) / (2 * width);
+    RunTasks(static_cast<int>(merges), [&](int i) {
+      const ptrdiff_t begin = 2 * width * i;
+      const ptrdiff_t end =
+          begin + 2 * width < blocks ? begin + 2 * width : blocks;
+      std::inplace_merge(first + bounds[begin],
+                         first + bounds[begin + width],
+                         first + bounds[end], compare);
+    });
+  }
+}
+
+}  // namespace win
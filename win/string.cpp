@@ -57,6 +57,23 @@ std::string WstrToStr(const std::wstring& str, UINT code_page) {
   return std::string();
 }
 
+std::string GetSortKey(const std::wstring& str, DWORD flags, LPCWSTR locale) {
+  flags |= LCMAP_SORTKEY;
+
+  int length = LCMapStringEx(locale, flags, str.c_str(), -1, nullptr, 0,
+                             nullptr, nullptr, 0);
+  if (length > 0) {
+    std::vector<char> output(length);
+    length = LCMapStringEx(locale, flags, str.c_str(), -1,
+                           reinterpret_cast<LPWSTR>(&output[0]), length,
+                           nullptr, nullptr, 0);
+    if (length > 0)
+      return std::string(&output[0], length - 1);
+  }
+
+  return std::string();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void ReadStringFromResource(LPCWSTR name, LPCWSTR type, std::wstring& output) {
@@ -33,6 +33,12 @@ namespace win {
 std::wstring StrToWstr(const std::string& str, UINT code_page = CP_UTF8);
 std::string WstrToStr(const std::wstring& str, UINT code_page = CP_UTF8);
 
+// Returns a collation key for the locale, which can be compared bytewise
+// instead of calling CompareStringEx for every comparison.
+std::string GetSortKey(const std::wstring& str,
+                       DWORD flags = NORM_IGNORECASE | SORT_DIGITSASNUMBERS,
+                       LPCWSTR locale = LOCALE_NAME_USER_DEFAULT);
+
 void ReadStringFromResource(LPCWSTR name, LPCWSTR type, std::wstring& output);
 
 }  // namespace win
@@ -0,0 +1,256 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma comment(lib, "msimg32.lib")
+
+#include "raster.h"
+#include "surface.h"
+
+namespace win {
+
+Surface::Surface()
+    : dc_(nullptr),
+      bitmap_(nullptr),
+      bitmap_old_(nullptr),
+      bits_(nullptr) {
+}
+
+Surface::~Surface() {
+  Destroy();
+}
+
+bool Surface::Create(int width, int height) {
+  if (width <= 0 || height <= 0)
+    return false;
+  if (bitmap_ && width == size_.cx && height == size_.cy)
+    return true;
+
+  Destroy();
+
+  BITMAPINFO bmi = {0};
+  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bmi.bmiHeader.biWidth = width;
+  bmi.bmiHeader.biHeight = -height;  // top-down
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+
+  dc_ = ::CreateCompatibleDC(nullptr);
+  if (!dc_)
+    return false;
+
+  bitmap_ = ::CreateDIBSection(dc_, &bmi, DIB_RGB_COLORS, &bits_, nullptr, 0);
+  if (!bitmap_) {
+    Destroy();
+    return false;
+  }
+  bitmap_old_ = reinterpret_cast<HBITMAP>(::SelectObject(dc_, bitmap_));
+
+  size_ = Size(width, height);
+
+  return true;
+}
+
+void Surface::Destroy() {
+  if (dc_) {
+    if (bitmap_old_)
+      ::SelectObject(dc_, bitmap_old_);
+    ::DeleteDC(dc_);
+    dc_ = nullptr;
+  }
+  if (bitmap_) {
+    ::DeleteObject(bitmap_);
+    bitmap_ = nullptr;
+  }
+
+  bitmap_old_ = nullptr;
+  bits_ = nullptr;
+  size_ = Size();
+}
+
+HBITMAP Surface::DetachBitmap() {
+  HBITMAP bitmap = bitmap_;
+  if (dc_ && bitmap_old_)
+    ::SelectObject(dc_, bitmap_old_);
+  bitmap_old_ = nullptr;
+  bitmap_ = nullptr;
+
+  Destroy();
+  return bitmap;
+}
+
+HDC Surface::GetDc() {
+  return dc_;
+}
+
+HBITMAP Surface::GetBitmap() const {
+  return bitmap_;
+}
+
+// Drawing through the DC may still be batched, so it is flushed before the
+// pixels are accessed.
+uint32_t* Surface::GetPixels() {
+  return const_cast<uint32_t*>(static_cast<const Surface*>(this)->GetPixels());
+}
+
+const uint32_t* Surface::GetPixels() const {
+  if (bits_)
+    ::GdiFlush();
+  return static_cast<const uint32_t*>(bits_);
+}
+
+uint32_t* Surface::GetRow(int y) {
+  return const_cast<uint32_t*>(static_cast<const Surface*>(this)->GetRow(y));
+}
+
+const uint32_t* Surface::GetRow(int y) const {
+  const uint32_t* pixels = GetPixels();
+  return pixels ? pixels + y * size_.cx : nullptr;
+}
+
+int Surface::GetStride() const {
+  return size_.cx * 4;
+}
+
+SIZE Surface::GetSize() const {
+  return size_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Surface::Fill(const RECT& rect, uint32_t color) {
+  Rect area;
+  if (!bits_ || !area.Intersect(rect, Rect(0, 0, size_.cx, size_.cy)))
+    return;
+
+  FillPixels(GetRow(area.top) + area.left, GetStride(),
+             area.Width(), area.Height(), color);
+}
+
+void Surface::Tint(const RECT& rect, uint32_t color) {
+  Rect area;
+  if (!bits_ || !area.Intersect(rect, Rect(0, 0, size_.cx, size_.cy)))
+    return;
+
+  TintPixels(GetRow(area.top) + area.left, GetStride(),
+             area.Width(), area.Height(), color);
+}
+
+void Surface::Copy(int x, int y, const Surface& source,
+                   const RECT& source_rect) {
+  Rect area;
+  if (!ClipBlit(x, y, source, source_rect, area))
+    return;
+
+  const uint32_t* src = source.GetRow(area.top) + area.left;
+  uint32_t* dst = GetRow(y) + x;
+  ptrdiff_t src_stride = source.GetStride();
+  ptrdiff_t dst_stride = GetStride();
+
+  // Overlapping rows within the same surface are copied from the bottom up
+  if (&source == this && y > area.top) {
+    src += (area.Height() - 1) * size_.cx;
+    dst += (area.Height() - 1) * size_.cx;
+    src_stride = -src_stride;
+    dst_stride = -dst_stride;
+  }
+
+  CopyPixels(dst, dst_stride, src, src_stride, area.Width(), area.Height());
+}
+
+void Surface::Blend(int x, int y, const Surface& source,
+                    const RECT& source_rect) {
+  Rect area;
+  if (&source == this || !ClipBlit(x, y, source, source_rect, area))
+    return;
+
+  BlendPixels(GetRow(y) + x, GetStride(),
+              source.GetRow(area.top) + area.left, source.GetStride(),
+              area.Width(), area.Height());
+}
+
+// The mask cannot be clipped from the left without shifting its bits, so it
+// must start inside the surface.
+void Surface::ExpandMask(int x, int y, const uint8_t* mask, int mask_stride,
+                         int width, int height,
+                         uint32_t foreground, uint32_t background) {
+  if (!bits_ || !mask || x < 0 || x >= size_.cx || y >= size_.cy)
+    return;
+
+  if (y < 0) {
+    mask += -y * mask_stride;
+    height += y;
+    y = 0;
+  }
+  if (width > size_.cx - x)
+    width = size_.cx - x;
+  if (height > size_.cy - y)
+    height = size_.cy - y;
+  if (width <= 0 || height <= 0)
+    return;
+
+  win::ExpandMask(GetRow(y) + x, GetStride(), mask, mask_stride,
+                  width, height, foreground, background);
+}
+
+BOOL Surface::Draw(HDC hdc, int x, int y, BYTE alpha) const {
+  if (!dc_)
+    return FALSE;
+
+  BLENDFUNCTION blend = {AC_SRC_OVER, 0, alpha, AC_SRC_ALPHA};
+  return ::AlphaBlend(hdc, x, y, size_.cx, size_.cy,
+                      dc_, 0, 0, size_.cx, size_.cy, blend);
+}
+
+// Clips the source rectangle to both surfaces, adjusting the destination
+// position to match.
+bool Surface::ClipBlit(int& x, int& y, const Surface& source,
+                       const RECT& source_rect, Rect& area) const {
+  if (!bits_ || !source.bits_)
+    return false;
+
+  SIZE source_size = source.GetSize();
+  if (!area.Intersect(source_rect,
+                      Rect(0, 0, source_size.cx, source_size.cy)))
+    return false;
+
+  x += area.left - source_rect.left;
+  y += area.top - source_rect.top;
+
+  Rect target(x, y, x + area.Width(), y + area.Height());
+  Rect clipped;
+  if (!clipped.Intersect(target, Rect(0, 0, size_.cx, size_.cy)))
+    return false;
+
+  area.left += clipped.left - x;
+  area.top += clipped.top - y;
+  area.right = area.left + clipped.Width();
+  area.bottom = area.top + clipped.Height();
+  x = clipped.left;
+  y = clipped.top;
+
+  return true;
+}
+
+}  // namespace win
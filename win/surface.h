@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include <windows.h>
+
+#include "geometry.h"
+
+namespace win {
+
+// A 32-bit top-down DIB section holding premultiplied ARGB pixels, which can
+// be drawn to both through GDI and directly in memory. The raster operations
+// are clipped to the surface.
+
+class Surface {
+public:
+  Surface();
+  ~Surface();
+
+  bool Create(int width, int height);
+  void Destroy();
+  // Releases the bitmap to the caller and destroys the surface.
+  HBITMAP DetachBitmap();
+
+  // Drawing through the DC changes the pixels, so it is only available on
+  // surfaces that can be modified.
+  HDC             GetDc();
+  HBITMAP         GetBitmap() const;
+  uint32_t*       GetPixels();
+  const uint32_t* GetPixels() const;
+  uint32_t*       GetRow(int y);
+  const uint32_t* GetRow(int y) const;
+  int             GetStride() const;
+  SIZE            GetSize() const;
+
+  void Fill(const RECT& rect, uint32_t color);
+  void Tint(const RECT& rect, uint32_t color);
+  void Copy(int x, int y, const Surface& source, const RECT& source_rect);
+  void Blend(int x, int y, const Surface& source, const RECT& source_rect);
+  void ExpandMask(int x, int y, const uint8_t* mask, int mask_stride,
+                  int width, int height,
+                  uint32_t foreground, uint32_t background);
+
+  // Alpha blends the surface onto a device context.
+  BOOL Draw(HDC hdc, int x, int y, BYTE alpha = 255) const;
+
+private:
+  bool ClipBlit(int& x, int& y, const Surface& source, const RECT& source_rect,
+                Rect& area) const;
+
+  HDC     dc_;
+  HBITMAP bitmap_;
+  HBITMAP bitmap_old_;
+  void*   bits_;
+  Size    size_;
+};
+
+}  // namespace win
@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include "icon_cache.h"
 #include "taskbar.h"
 
 const DWORD WM_TASKBARCALLBACK = WM_APP + 0x15;
@@ -31,7 +32,8 @@ const DWORD WM_TASKBARBUTTONCREATED = ::RegisterWindowMessage(L"TaskbarButtonCre
 namespace win {
 
 Taskbar::Taskbar()
-    : hwnd_(nullptr) {
+    : hwnd_(nullptr),
+      icon_(nullptr) {
   data_.cbSize = sizeof(data_);
 }
 
@@ -51,11 +53,10 @@ BOOL Taskbar::Create(HWND hwnd, UINT uid, HICON icon, LPCWSTR tip) {
   data_.uID = uid;
   data_.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
 
-  if (!icon)
-    data_.hIcon = reinterpret_cast<HICON>(LoadImage(
-        GetModuleHandle(nullptr), MAKEINTRESOURCE(101), IMAGE_ICON,
-        GetSystemMetrics(SM_CXSMICON), GetSystemMetrics(SM_CYSMICON),
-        LR_DEFAULTCOLOR));
+  if (!icon) {
+    icon_ = GetIconCache().Load(GetModuleHandle(nullptr), 101, kIconSmall);
+    data_.hIcon = icon_;
+  }
 
   if (tip)
     wcscpy_s(data_.szTip, tip);
@@ -67,7 +68,14 @@ BOOL Taskbar::Destroy() {
   if (!hwnd_)
     return FALSE;
 
-  return ::Shell_NotifyIcon(NIM_DELETE, &data_);
+  BOOL result = ::Shell_NotifyIcon(NIM_DELETE, &data_);
+
+  if (icon_) {
+    ReleaseIcon(icon_);
+    icon_ = nullptr;
+  }
+
+  return result;
 }
 
 BOOL Taskbar::Modify(LPCWSTR tip) {
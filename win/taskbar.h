@@ -45,6 +45,7 @@ public:
 
 private:
   HWND hwnd_;
+  HICON icon_;
   NOTIFYICONDATA data_;
 };
 
@@ -0,0 +1,285 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma comment(lib, "usp10.lib")
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include <usp10.h>
+
+#include "text_layout.h"
+
+namespace win {
+
+// Flags that only change where the text is drawn, not how it is laid out
+const UINT kTextLayoutPositionFormat =
+    DT_BOTTOM | DT_CALCRECT | DT_CENTER | DT_NOCLIP | DT_RIGHT | DT_VCENTER;
+
+TextLayoutCache::TextLayoutCache(size_t max_bytes)
+    : layouts_(max_bytes) {
+}
+
+const TextLayout& TextLayoutCache::Measure(HDC hdc, const std::wstring& text,
+                                           int width, UINT format) {
+  format &= ~kTextLayoutPositionFormat;
+  // Width only matters if lines are wrapped, and DrawText would otherwise
+  // break after every word when it is zero
+  if (!(format & DT_WORDBREAK) || (format & DT_SINGLELINE) || width <= 0) {
+    format &= ~DT_WORDBREAK;
+    width = 0;
+  }
+
+  HFONT font = reinterpret_cast<HFONT>(::GetCurrentObject(hdc, OBJ_FONT));
+  const Key key(font, std::hash<std::wstring>()(text), width, format);
+
+  // Hash collisions are resolved by measuring again
+  TextLayout* cached_layout = layouts_.Get(key);
+  if (cached_layout && cached_layout->text == text)
+    return *cached_layout;
+
+  TextLayout layout;
+  layout.text = text;
+
+  RECT rect = {0, 0, width, 0};
+  ::DrawText(hdc, text.c_str(), static_cast<int>(text.size()), &rect,
+             format | DT_CALCRECT);
+  layout.extent.cx = rect.right - rect.left;
+  layout.extent.cy = rect.bottom - rect.top;
+
+  BreakLines(hdc, width, format, layout);
+
+  const size_t cost = sizeof(TextLayout) +
+                      layout.text.size() * sizeof(wchar_t) +
+                      layout.line_starts.size() * sizeof(size_t);
+  return layouts_.Put(key, std::move(layout), cost);
+}
+
+int TextLayoutCache::GetHeight(HDC hdc, const std::wstring& text, int width,
+                               UINT format) {
+  return Measure(hdc, text, width, format).extent.cy;
+}
+
+int TextLayoutCache::GetMaxWidth(HDC hdc,
+                                 const std::vector<std::wstring>& texts,
+                                 UINT format) {
+  int max_width = 0;
+
+  for (const auto& text : texts) {
+    const int text_width = Measure(hdc, text, 0, format).extent.cx;
+    if (text_width > max_width)
+      max_width = text_width;
+  }
+
+  return max_width;
+}
+
+void TextLayoutCache::Clear() {
+  layouts_.Clear();
+}
+
+void TextLayoutCache::RemoveFont(HFONT font) {
+  layouts_.EraseIf([&font](const Key& key, const TextLayout&) {
+    return std::get<0>(key) == font;
+  });
+}
+
+// Follows the rules of DrawText closely enough to find where lines start.
+// Lines are wrapped after the last space that fits, or inside a word that is
+// wider than the whole line.
+void TextLayoutCache::BreakLines(HDC hdc, int width, UINT format,
+                                 TextLayout& layout) const {
+  const std::wstring& text = layout.text;
+
+  layout.line_starts.assign(1, 0);
+  if (format & DT_SINGLELINE)
+    return;
+
+  const bool wrap = (format & DT_WORDBREAK) && width > 0;
+
+  size_t line_start = 0;
+  while (line_start < text.size()) {
+    size_t line_end = text.find_first_of(L"\r\n", line_start);
+    if (line_end == std::wstring::npos)
+      line_end = text.size();
+
+    size_t pos = line_start;
+    while (wrap && pos < line_end) {
+      int fit = 0;
+      SIZE size;
+      ::GetTextExtentExPoint(hdc, text.c_str() + pos,
+                             static_cast<int>(line_end - pos), width, &fit,
+                             nullptr, &size);
+      size_t next = pos + fit;
+      if (next >= line_end)
+        break;
+
+      const size_t space = text.find_last_of(L' ', next);
+      if (space != std::wstring::npos && space > pos) {
+        next = space;
+      } else if (fit == 0) {
+        next = pos + 1;
+      }
+      while (next < line_end && text[next] == L' ')
+        ++next;
+      if (next >= line_end)
+        break;
+
+      layout.line_starts.push_back(next);
+      pos = next;
+    }
+
+    if (line_end >= text.size())
+      break;
+
+    line_start = line_end + 1;
+    if (text[line_end] == L'\r' && line_start < text.size() &&
+        text[line_start] == L'\n')
+      ++line_start;
+    layout.line_starts.push_back(line_start);
+  }
+}
+
+TextLayoutCache& GetTextLayoutCache() {
+  thread_local TextLayoutCache text_layout_cache;
+  return text_layout_cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GlyphRunCache::GlyphRunCache(size_t max_bytes)
+    : runs_(max_bytes) {
+}
+
+const GlyphRun* GlyphRunCache::Shape(HDC hdc, const std::wstring& text) {
+  HFONT font = reinterpret_cast<HFONT>(::GetCurrentObject(hdc, OBJ_FONT));
+  const int dpi = ::GetDeviceCaps(hdc, LOGPIXELSY);
+  const Key key(font, std::hash<std::wstring>()(text), dpi);
+
+  // Runs that could not be shaped are cached as well, so that they are not
+  // retried on every paint.
+  GlyphRun* cached_run = runs_.Get(key);
+  if (cached_run && cached_run->text == text)
+    return cached_run->shaped ? cached_run : nullptr;
+
+  GlyphRun run;
+  run.text = text;
+  run.shaped = ShapeText(hdc, run);
+
+  const size_t cost = sizeof(GlyphRun) +
+                      run.text.size() * sizeof(wchar_t) +
+                      run.glyphs.size() * sizeof(WORD) +
+                      run.advances.size() * sizeof(int);
+  const GlyphRun& stored_run = runs_.Put(key, std::move(run), cost);
+  return stored_run.shaped ? &stored_run : nullptr;
+}
+
+BOOL GlyphRunCache::Draw(HDC hdc, int x, int y, const std::wstring& text,
+                         UINT options, LPCRECT rect) {
+  const GlyphRun* run = Shape(hdc, text);
+
+  if (!run)
+    return ::ExtTextOutW(hdc, x, y, options, rect, text.c_str(),
+                         static_cast<UINT>(text.size()), nullptr);
+
+  return ::ExtTextOutW(hdc, x, y, options | ETO_GLYPH_INDEX, rect,
+                       reinterpret_cast<LPCWSTR>(run->glyphs.data()),
+                       static_cast<UINT>(run->glyphs.size()),
+                       run->advances.data());
+}
+
+void GlyphRunCache::Clear() {
+  runs_.Clear();
+}
+
+void GlyphRunCache::RemoveFont(HFONT font) {
+  runs_.EraseIf([&font](const Key& key, const GlyphRun&) {
+    return std::get<0>(key) == font;
+  });
+}
+
+bool GlyphRunCache::ShapeText(HDC hdc, GlyphRun& run) const {
+  const std::wstring& text = run.text;
+  const int length = static_cast<int>(text.size());
+  if (!length)
+    return false;
+
+  // GetCharacterPlacement does not handle complex scripts well
+  if (::ScriptIsComplex(text.c_str(), length, SIC_COMPLEX) == S_OK)
+    return false;
+
+  // Characters that are missing from the font need font fallback, which
+  // only happens when drawing text
+  std::vector<WORD> indices(length);
+  if (::GetGlyphIndicesW(hdc, text.c_str(), length, indices.data(),
+                         GGI_MARK_NONEXISTING_GLYPHS) == GDI_ERROR)
+    return false;
+  if (std::find(indices.begin(), indices.end(), 0xFFFF) != indices.end())
+    return false;
+
+  run.glyphs.assign(length, 0);
+  run.advances.assign(length, 0);
+
+  GCP_RESULTSW results = {0};
+  results.lStructSize = sizeof(GCP_RESULTSW);
+  results.lpGlyphs = reinterpret_cast<LPWSTR>(run.glyphs.data());
+  results.lpDx = run.advances.data();
+  results.nGlyphs = length;
+
+  const DWORD flags = ::GetFontLanguageInfo(hdc) & FLI_MASK;
+  const DWORD extent = ::GetCharacterPlacementW(hdc, text.c_str(), length, 0,
+                                                &results, flags);
+  if (!extent) {
+    run.glyphs.clear();
+    run.advances.clear();
+    return false;
+  }
+
+  run.glyphs.resize(results.nGlyphs);
+  run.advances.resize(results.nGlyphs);
+  run.extent.cx = LOWORD(extent);
+  run.extent.cy = HIWORD(extent);
+
+  return true;
+}
+
+GlyphRunCache& GetGlyphRunCache() {
+  thread_local GlyphRunCache glyph_run_cache;
+  return glyph_run_cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ClearTextCaches() {
+  GetTextLayoutCache().Clear();
+  GetGlyphRunCache().Clear();
+}
+
+void RemoveFontFromTextCaches(HFONT font) {
+  GetTextLayoutCache().RemoveFont(font);
+  GetGlyphRunCache().RemoveFont(font);
+}
+
+}  // namespace win
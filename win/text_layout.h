@@ -0,0 +1,119 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <windows.h>
+
+#include "lru_cache.h"
+
+namespace win {
+
+struct TextLayout {
+  std::wstring text;
+  SIZE extent = {0, 0};
+  // Offsets of the first character of each line
+  std::vector<size_t> line_starts;
+};
+
+// Caches DrawText measurements by font, text, width and format. Entries are
+// keyed by font handle, so fonts that are deleted while they may still be in
+// the cache must be removed with RemoveFontFromTextCaches.
+
+class TextLayoutCache {
+public:
+  TextLayoutCache(size_t max_bytes = 1024 * 1024);
+
+  // Measures the text with the font that is selected into the DC. A width of
+  // zero or less means that lines are not wrapped. The returned layout is
+  // valid until the next call.
+  const TextLayout& Measure(HDC hdc, const std::wstring& text, int width,
+                            UINT format);
+
+  int GetHeight(HDC hdc, const std::wstring& text, int width, UINT format);
+  int GetMaxWidth(HDC hdc, const std::vector<std::wstring>& texts,
+                  UINT format);
+
+  void Clear();
+  void RemoveFont(HFONT font);
+
+private:
+  typedef std::tuple<HFONT, size_t, int, UINT> Key;
+
+  void BreakLines(HDC hdc, int width, UINT format, TextLayout& layout) const;
+
+  LruCache<Key, TextLayout> layouts_;
+};
+
+TextLayoutCache& GetTextLayoutCache();
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct GlyphRun {
+  std::wstring text;
+  bool shaped = false;
+  SIZE extent = {0, 0};
+  std::vector<WORD> glyphs;
+  std::vector<int> advances;
+};
+
+// Caches the glyph indices and advances of single-line strings, so that they
+// can be drawn again without shaping. Text that needs font fallback or
+// complex script processing is not shaped, and is drawn as text instead.
+
+class GlyphRunCache {
+public:
+  GlyphRunCache(size_t max_bytes = 2 * 1024 * 1024);
+
+  // Returns nullptr if the text cannot be drawn from glyph indices. The
+  // returned run is valid until the next call.
+  const GlyphRun* Shape(HDC hdc, const std::wstring& text);
+
+  BOOL Draw(HDC hdc, int x, int y, const std::wstring& text,
+            UINT options = 0, LPCRECT rect = nullptr);
+
+  void Clear();
+  void RemoveFont(HFONT font);
+
+private:
+  // Font, text hash and DPI
+  typedef std::tuple<HFONT, size_t, int> Key;
+
+  bool ShapeText(HDC hdc, GlyphRun& run) const;
+
+  LruCache<Key, GlyphRun> runs_;
+};
+
+GlyphRunCache& GetGlyphRunCache();
+
+// Updates all text caches of the current thread
+void ClearTextCaches();
+void RemoveFontFromTextCaches(HFONT font);
+
+}  // namespace win
@@ -119,6 +119,22 @@ HANDLE Event::Create(LPSECURITY_ATTRIBUTES event_attributes, BOOL manual_reset,
   return event_;
 }
 
+HANDLE Event::Get() const {
+  return event_;
+}
+
+bool Event::Reset() {
+  return ::ResetEvent(event_) != FALSE;
+}
+
+bool Event::Set() {
+  return ::SetEvent(event_) != FALSE;
+}
+
+DWORD Event::Wait(DWORD milliseconds) const {
+  return ::WaitForSingleObject(event_, milliseconds);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 Lock::Lock(CriticalSection& critical_section)
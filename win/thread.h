@@ -77,6 +77,10 @@ public:
       BOOL manual_reset,
       BOOL initial_state,
       LPCTSTR name);
+  HANDLE Get() const;
+  bool Reset();
+  bool Set();
+  DWORD Wait(DWORD milliseconds = INFINITE) const;
 
 private:
   HANDLE event_;
@@ -0,0 +1,728 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "raster.h"
+#include "thumbnail_cache.h"
+
+namespace win {
+
+// File layout: a header, followed by the records, followed by the index.
+// Each record holds its own key, so that the index can be rebuilt by scanning
+// the records. Records and pixels are aligned to 16 bytes, and pixels are
+// stored as premultiplied ARGB, ready to be copied into a DIB section.
+
+const DWORD kThumbnailMagic = 0x43485457;        // "WTHC"
+const DWORD kThumbnailRecordMagic = 0x52485457;  // "WTHR"
+const DWORD kThumbnailVersion = 1;
+
+// Set while records have been appended over the index
+const DWORD kThumbnailDirty = 0x1;
+
+// Compressed pixels are reserved in the format, but not written yet
+const DWORD kThumbnailUncompressed = 0;
+
+const ULONGLONG kThumbnailAlignment = 16;
+const ULONGLONG kThumbnailGrowth = 16 * 1024 * 1024;
+const DWORD kThumbnailMaxPath = 32767;
+
+struct ThumbnailHeader {
+  DWORD magic;
+  DWORD version;
+  DWORD flags;
+  DWORD entry_count;
+  ULONGLONG data_end;
+  ULONGLONG index_offset;
+  ULONGLONG index_size;
+  DWORD index_checksum;
+  DWORD reserved[5];
+};
+
+struct ThumbnailRecord {
+  DWORD magic;
+  DWORD path_length;
+  DWORD width;
+  DWORD height;
+  DWORD image_width;
+  DWORD image_height;
+  DWORD compression;
+  DWORD checksum;
+  ULONGLONG source_size;
+  ULONGLONG source_time;
+  ULONGLONG data_size;
+};
+
+// Index entries are followed by their paths, in the same order
+struct ThumbnailIndexEntry {
+  ULONGLONG record_offset;
+  ULONGLONG record_size;
+  ULONGLONG source_size;
+  ULONGLONG source_time;
+  DWORD width;
+  DWORD height;
+  DWORD last_use;
+  DWORD path_length;
+};
+
+DWORD ThumbnailChecksum(const BYTE* data, size_t size) {
+  // FNV-1a
+  DWORD hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+ULONGLONG AlignThumbnailOffset(ULONGLONG offset) {
+  return (offset + kThumbnailAlignment - 1) & ~(kThumbnailAlignment - 1);
+}
+
+ULONGLONG GetThumbnailPixelsOffset(ULONGLONG record_offset,
+                                   DWORD path_length) {
+  return AlignThumbnailOffset(record_offset + sizeof(ThumbnailRecord) +
+                              path_length * sizeof(WCHAR));
+}
+
+// Paths are compared case-insensitively, as in the file system
+std::wstring NormalizeThumbnailPath(const std::wstring& file) {
+  std::wstring path = file;
+  if (!path.empty())
+    ::CharLowerBuff(&path[0], static_cast<DWORD>(path.size()));
+  return path;
+}
+
+bool GetThumbnailSource(const std::wstring& file, ULONGLONG& size,
+                        ULONGLONG& time) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!::GetFileAttributesEx(file.c_str(), GetFileExInfoStandard, &data))
+    return false;
+
+  size = (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) |
+         data.nFileSizeLow;
+  time = (static_cast<ULONGLONG>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+         data.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+void FillThumbnailHeader(ThumbnailHeader& header, DWORD entry_count,
+                         ULONGLONG data_end, const std::vector<BYTE>& index) {
+  ::memset(&header, 0, sizeof(ThumbnailHeader));
+  header.magic = kThumbnailMagic;
+  header.version = kThumbnailVersion;
+  header.entry_count = entry_count;
+  header.data_end = data_end;
+  header.index_offset = data_end;
+  header.index_size = index.size();
+  header.index_checksum = ThumbnailChecksum(index.data(), index.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ThumbnailCache::ThumbnailCache()
+    : file_(nullptr),
+      mapping_(nullptr),
+      view_(nullptr),
+      capacity_(0),
+      data_end_(0),
+      live_size_(0),
+      max_size_(0),
+      use_counter_(0),
+      dirty_(false),
+      modified_(false) {
+}
+
+ThumbnailCache::~ThumbnailCache() {
+  Close();
+}
+
+bool ThumbnailCache::Open(const std::wstring& path, ULONGLONG max_size) {
+  Lock lock(critical_section_);
+
+  Close();
+
+  path_ = path;
+  max_size_ = max_size;
+
+  if (!Load()) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+// Writes the index, then truncates the file to its end.
+void ThumbnailCache::Close() {
+  Lock lock(critical_section_);
+
+  if (view_) {
+    Flush();
+
+    const auto& header = *reinterpret_cast<const ThumbnailHeader*>(view_);
+    LARGE_INTEGER end;
+    end.QuadPart = dirty_ ? data_end_ :
+                            header.index_offset + header.index_size;
+    Unmap();
+
+    if (::SetFilePointerEx(file_, end, nullptr, FILE_BEGIN))
+      ::SetEndOfFile(file_);
+  }
+
+  Unmap();
+  if (file_) {
+    ::CloseHandle(file_);
+    file_ = nullptr;
+  }
+
+  entries_.clear();
+  data_end_ = 0;
+  live_size_ = 0;
+  use_counter_ = 0;
+  dirty_ = false;
+  modified_ = false;
+}
+
+bool ThumbnailCache::Flush() {
+  Lock lock(critical_section_);
+
+  if (!view_)
+    return false;
+  if (!dirty_ && !modified_)
+    return true;
+
+  return WriteIndex();
+}
+
+bool ThumbnailCache::IsOpen() const {
+  Lock lock(critical_section_);
+  return view_ != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ThumbnailCache::Get(const std::wstring& file, UINT width, UINT height,
+                         Surface& surface) {
+  Lock lock(critical_section_);
+
+  if (!view_)
+    return false;
+
+  auto it = entries_.find(Key(NormalizeThumbnailPath(file), width, height));
+  if (it == entries_.end())
+    return false;
+
+  // Thumbnails of modified files are dropped
+  ULONGLONG source_size = 0;
+  ULONGLONG source_time = 0;
+  if (!GetThumbnailSource(file, source_size, source_time) ||
+      source_size != it->second.source_size ||
+      source_time != it->second.source_time) {
+    live_size_ -= it->second.record_size;
+    entries_.erase(it);
+    modified_ = true;
+    return false;
+  }
+
+  Entry& entry = it->second;
+  const auto& record =
+      *reinterpret_cast<const ThumbnailRecord*>(view_ + entry.record_offset);
+  const ULONGLONG pixels_offset =
+      GetThumbnailPixelsOffset(entry.record_offset, record.path_length);
+  if (pixels_offset + record.data_size >
+          entry.record_offset + entry.record_size ||
+      record.data_size != static_cast<ULONGLONG>(record.image_width) *
+                          record.image_height * 4)
+    return false;
+
+  if (!surface.Create(record.image_width, record.image_height))
+    return false;
+
+  const auto pixels =
+      reinterpret_cast<const uint32_t*>(view_ + pixels_offset);
+
+  CopyPixels(surface.GetPixels(), surface.GetStride(),
+             pixels, record.image_width * 4,
+             record.image_width, record.image_height);
+
+  entry.last_use = ++use_counter_;
+  modified_ = true;
+
+  return true;
+}
+
+bool ThumbnailCache::Put(const std::wstring& file, UINT width, UINT height,
+                         const Surface& surface) {
+  Lock lock(critical_section_);
+
+  const SIZE size = surface.GetSize();
+  const uint32_t* pixels = surface.GetPixels();
+  if (!view_ || !pixels)
+    return false;
+
+  ULONGLONG source_size = 0;
+  ULONGLONG source_time = 0;
+  if (!GetThumbnailSource(file, source_size, source_time))
+    return false;
+
+  const std::wstring path = NormalizeThumbnailPath(file);
+  if (path.size() > kThumbnailMaxPath)
+    return false;
+  const DWORD path_length = static_cast<DWORD>(path.size());
+
+  const ULONGLONG data_size = static_cast<ULONGLONG>(size.cx) * size.cy * 4;
+  const ULONGLONG record_size = AlignThumbnailOffset(
+      GetThumbnailPixelsOffset(0, path_length) + data_size);
+  if (sizeof(ThumbnailHeader) + record_size > max_size_)
+    return false;
+
+  // Leave some room after compacting, so that it is not repeated for every
+  // new entry.
+  if (data_end_ + record_size > max_size_) {
+    const ULONGLONG target = max_size_ / 4 * 3;
+    if (!CompactTo(target > record_size ? target - record_size : 0))
+      return false;
+  }
+
+  if (!Reserve(data_end_ + record_size))
+    return false;
+
+  MarkDirty();
+
+  const ULONGLONG pixels_offset =
+      GetThumbnailPixelsOffset(data_end_, path_length);
+  CopyPixels(reinterpret_cast<uint32_t*>(view_ + pixels_offset), size.cx * 4,
+             pixels, surface.GetStride(), size.cx, size.cy);
+
+  auto& record = *reinterpret_cast<ThumbnailRecord*>(view_ + data_end_);
+  record.magic = kThumbnailRecordMagic;
+  record.path_length = path_length;
+  record.width = width;
+  record.height = height;
+  record.image_width = size.cx;
+  record.image_height = size.cy;
+  record.compression = kThumbnailUncompressed;
+  record.checksum = ThumbnailChecksum(view_ + pixels_offset,
+                                      static_cast<size_t>(data_size));
+  record.source_size = source_size;
+  record.source_time = source_time;
+  record.data_size = data_size;
+  ::memcpy(view_ + data_end_ + sizeof(ThumbnailRecord), path.data(),
+           path_length * sizeof(WCHAR));
+
+  Entry& entry = entries_[Key(path, width, height)];
+  live_size_ -= entry.record_size;
+  entry.record_offset = data_end_;
+  entry.record_size = record_size;
+  entry.source_size = source_size;
+  entry.source_time = source_time;
+  entry.last_use = ++use_counter_;
+  live_size_ += record_size;
+
+  data_end_ += record_size;
+
+  return true;
+}
+
+bool ThumbnailCache::Remove(const std::wstring& file, UINT width,
+                            UINT height) {
+  Lock lock(critical_section_);
+
+  auto it = entries_.find(Key(NormalizeThumbnailPath(file), width, height));
+  if (it == entries_.end())
+    return false;
+
+  live_size_ -= it->second.record_size;
+  entries_.erase(it);
+  modified_ = true;
+
+  return true;
+}
+
+bool ThumbnailCache::Compact() {
+  Lock lock(critical_section_);
+
+  if (!view_)
+    return false;
+
+  return CompactTo(max_size_);
+}
+
+void ThumbnailCache::SetMaxSize(ULONGLONG max_size) {
+  Lock lock(critical_section_);
+
+  max_size_ = max_size;
+  if (view_ && data_end_ > max_size_)
+    CompactTo(max_size_);
+}
+
+ULONGLONG ThumbnailCache::GetSize() const {
+  Lock lock(critical_section_);
+  return data_end_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ThumbnailCache::Load() {
+  HANDLE file_handle = ::CreateFile(path_.c_str(),
+                                    GENERIC_READ | GENERIC_WRITE,
+                                    FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return false;
+  file_ = file_handle;
+
+  LARGE_INTEGER file_size = {0};
+  if (!::GetFileSizeEx(file_, &file_size))
+    return false;
+
+  if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(ThumbnailHeader)))
+    return Initialize();
+
+  if (!Map(file_size.QuadPart))
+    return false;
+
+  const auto& header = *reinterpret_cast<const ThumbnailHeader*>(view_);
+  if (header.magic != kThumbnailMagic || header.version != kThumbnailVersion)
+    return Initialize();
+
+  if (header.flags & kThumbnailDirty) {
+    dirty_ = true;
+    RebuildIndex();
+  } else if (!ReadIndex()) {
+    RebuildIndex();
+  }
+
+  return true;
+}
+
+bool ThumbnailCache::Map(ULONGLONG size) {
+  Unmap();
+
+  mapping_ = ::CreateFileMapping(file_, nullptr, PAGE_READWRITE,
+                                 static_cast<DWORD>(size >> 32),
+                                 static_cast<DWORD>(size), nullptr);
+  if (!mapping_)
+    return false;
+
+  view_ = static_cast<BYTE*>(::MapViewOfFile(mapping_, FILE_MAP_WRITE,
+                                             0, 0, 0));
+  if (!view_) {
+    Unmap();
+    return false;
+  }
+
+  capacity_ = size;
+  return true;
+}
+
+void ThumbnailCache::Unmap() {
+  if (view_) {
+    ::UnmapViewOfFile(view_);
+    view_ = nullptr;
+  }
+  if (mapping_) {
+    ::CloseHandle(mapping_);
+    mapping_ = nullptr;
+  }
+
+  capacity_ = 0;
+}
+
+bool ThumbnailCache::Initialize() {
+  if (!Map(kThumbnailGrowth))
+    return false;
+
+  auto& header = *reinterpret_cast<ThumbnailHeader*>(view_);
+  FillThumbnailHeader(header, 0, sizeof(ThumbnailHeader), std::vector<BYTE>());
+  header.flags = kThumbnailDirty;
+
+  entries_.clear();
+  data_end_ = sizeof(ThumbnailHeader);
+  live_size_ = 0;
+  use_counter_ = 0;
+  dirty_ = true;
+  modified_ = true;
+
+  return true;
+}
+
+bool ThumbnailCache::ReadIndex() {
+  const auto& header = *reinterpret_cast<const ThumbnailHeader*>(view_);
+
+  const ULONGLONG entries_size =
+      static_cast<ULONGLONG>(header.entry_count) * sizeof(ThumbnailIndexEntry);
+  if (header.data_end < sizeof(ThumbnailHeader) ||
+      header.index_offset != header.data_end ||
+      header.index_offset % kThumbnailAlignment ||
+      header.index_size < entries_size ||
+      header.index_offset + header.index_size > capacity_)
+    return false;
+
+  const BYTE* index = view_ + header.index_offset;
+  if (header.index_checksum !=
+      ThumbnailChecksum(index, static_cast<size_t>(header.index_size)))
+    return false;
+
+  const auto items = reinterpret_cast<const ThumbnailIndexEntry*>(index);
+  auto path = reinterpret_cast<const WCHAR*>(index + entries_size);
+  ULONGLONG path_remaining = (header.index_size - entries_size) / sizeof(WCHAR);
+
+  entries_.clear();
+  live_size_ = 0;
+  use_counter_ = 0;
+
+  for (DWORD i = 0; i < header.entry_count; i++) {
+    const auto& item = items[i];
+    if (item.path_length > path_remaining ||
+        item.record_offset < sizeof(ThumbnailHeader) ||
+        item.record_offset + item.record_size > header.data_end) {
+      entries_.clear();
+      live_size_ = 0;
+      return false;
+    }
+
+    Entry entry = {item.record_offset, item.record_size, item.source_size,
+                   item.source_time, item.last_use};
+    entries_[Key(std::wstring(path, item.path_length),
+                 item.width, item.height)] = entry;
+    live_size_ += item.record_size;
+    if (item.last_use > use_counter_)
+      use_counter_ = item.last_use;
+
+    path += item.path_length;
+    path_remaining -= item.path_length;
+  }
+
+  data_end_ = header.data_end;
+  return true;
+}
+
+// Scans the records up to the first one that is incomplete. Records are
+// appended in the order they were used, and later records replace earlier
+// ones with the same key.
+void ThumbnailCache::RebuildIndex() {
+  entries_.clear();
+  live_size_ = 0;
+  use_counter_ = 0;
+
+  ULONGLONG offset = sizeof(ThumbnailHeader);
+  while (offset + sizeof(ThumbnailRecord) <= capacity_) {
+    const auto& record =
+        *reinterpret_cast<const ThumbnailRecord*>(view_ + offset);
+    if (record.magic != kThumbnailRecordMagic ||
+        record.path_length > kThumbnailMaxPath ||
+        record.compression != kThumbnailUncompressed ||
+        record.data_size != static_cast<ULONGLONG>(record.image_width) *
+                            record.image_height * 4)
+      break;
+
+    const ULONGLONG pixels_offset =
+        GetThumbnailPixelsOffset(offset, record.path_length);
+    const ULONGLONG end = AlignThumbnailOffset(pixels_offset +
+                                               record.data_size);
+    if (end > capacity_ ||
+        record.checksum != ThumbnailChecksum(
+            view_ + pixels_offset, static_cast<size_t>(record.data_size)))
+      break;
+
+    const auto path = reinterpret_cast<const WCHAR*>(
+        view_ + offset + sizeof(ThumbnailRecord));
+    Entry& entry = entries_[Key(std::wstring(path, record.path_length),
+                                record.width, record.height)];
+    live_size_ -= entry.record_size;
+    entry.record_offset = offset;
+    entry.record_size = end - offset;
+    entry.source_size = record.source_size;
+    entry.source_time = record.source_time;
+    entry.last_use = ++use_counter_;
+    live_size_ += entry.record_size;
+
+    offset = end;
+  }
+
+  data_end_ = offset;
+  modified_ = true;
+}
+
+void ThumbnailCache::BuildIndex(const std::map<Key, Entry>& entries,
+                                std::vector<BYTE>& output) const {
+  size_t path_size = 0;
+  for (const auto& it : entries)
+    path_size += std::get<0>(it.first).size() * sizeof(WCHAR);
+
+  const size_t entries_size = entries.size() * sizeof(ThumbnailIndexEntry);
+  output.assign(entries_size + path_size, 0);
+
+  auto item = reinterpret_cast<ThumbnailIndexEntry*>(output.data());
+  auto path = reinterpret_cast<WCHAR*>(output.data() + entries_size);
+
+  for (const auto& it : entries) {
+    const std::wstring& key_path = std::get<0>(it.first);
+    item->record_offset = it.second.record_offset;
+    item->record_size = it.second.record_size;
+    item->source_size = it.second.source_size;
+    item->source_time = it.second.source_time;
+    item->width = std::get<1>(it.first);
+    item->height = std::get<2>(it.first);
+    item->last_use = it.second.last_use;
+    item->path_length = static_cast<DWORD>(key_path.size());
+    ::memcpy(path, key_path.data(), key_path.size() * sizeof(WCHAR));
+    path += key_path.size();
+    ++item;
+  }
+}
+
+// The index is flushed before the header, so that a crash in between leaves
+// the dirty flag set.
+bool ThumbnailCache::WriteIndex() {
+  std::vector<BYTE> index;
+  BuildIndex(entries_, index);
+
+  if (!Reserve(data_end_ + index.size()))
+    return false;
+
+  if (!index.empty())
+    ::memcpy(view_ + data_end_, index.data(), index.size());
+  ::FlushViewOfFile(view_, static_cast<SIZE_T>(data_end_ + index.size()));
+
+  auto& header = *reinterpret_cast<ThumbnailHeader*>(view_);
+  FillThumbnailHeader(header, static_cast<DWORD>(entries_.size()), data_end_,
+                      index);
+  ::FlushViewOfFile(view_, sizeof(ThumbnailHeader));
+
+  dirty_ = false;
+  modified_ = false;
+
+  return true;
+}
+
+void ThumbnailCache::MarkDirty() {
+  if (!dirty_) {
+    auto& header = *reinterpret_cast<ThumbnailHeader*>(view_);
+    header.flags |= kThumbnailDirty;
+    ::FlushViewOfFile(view_, sizeof(ThumbnailHeader));
+    dirty_ = true;
+  }
+
+  modified_ = true;
+}
+
+// The mapping grows in large steps, as it must be recreated each time
+bool ThumbnailCache::Reserve(ULONGLONG size) {
+  if (size <= capacity_)
+    return true;
+
+  const ULONGLONG capacity =
+      (size + kThumbnailGrowth - 1) / kThumbnailGrowth * kThumbnailGrowth;
+  return Map(capacity);
+}
+
+// Writes the most recently used entries that fit in the given size to a new
+// file, which then replaces the current one.
+bool ThumbnailCache::CompactTo(ULONGLONG size) {
+  std::vector<std::map<Key, Entry>::const_iterator> order;
+  order.reserve(entries_.size());
+  for (auto it = entries_.cbegin(); it != entries_.cend(); ++it)
+    order.push_back(it);
+  std::sort(order.begin(), order.end(),
+      [](std::map<Key, Entry>::const_iterator a,
+         std::map<Key, Entry>::const_iterator b) {
+        return a->second.last_use > b->second.last_use;
+      });
+
+  std::map<Key, Entry> kept;
+  std::vector<std::map<Key, Entry>::const_iterator> records;
+  ULONGLONG offset = sizeof(ThumbnailHeader);
+  for (const auto& it : order) {
+    if (offset + it->second.record_size > size)
+      continue;
+    Entry entry = it->second;
+    entry.record_offset = offset;
+    kept[it->first] = entry;
+    records.push_back(it);
+    offset += entry.record_size;
+  }
+
+  std::vector<BYTE> index;
+  BuildIndex(kept, index);
+  ThumbnailHeader header;
+  FillThumbnailHeader(header, static_cast<DWORD>(kept.size()), offset, index);
+
+  // Write to a temporary file first, so that a failure leaves the current
+  // file intact.
+  const std::wstring temp_path = path_ + L".tmp";
+  HANDLE temp_file = ::CreateFile(temp_path.c_str(), GENERIC_WRITE, 0,
+                                  nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (temp_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  const auto write = [temp_file](const void* data, ULONGLONG data_size) {
+    DWORD bytes_written = 0;
+    return data_size == 0 ||
+           (::WriteFile(temp_file, data, static_cast<DWORD>(data_size),
+                        &bytes_written, nullptr) &&
+            bytes_written == data_size);
+  };
+
+  // Records are written in the order their new offsets were assigned
+  bool result = write(&header, sizeof(ThumbnailHeader));
+  for (const auto& it : records) {
+    if (!result)
+      break;
+    result = write(view_ + it->second.record_offset, it->second.record_size);
+  }
+  if (result)
+    result = write(index.data(), index.size());
+
+  ::CloseHandle(temp_file);
+
+  if (result) {
+    Unmap();
+    ::CloseHandle(file_);
+    file_ = nullptr;
+
+    result = ::MoveFileEx(temp_path.c_str(), path_.c_str(),
+                          MOVEFILE_REPLACE_EXISTING) != FALSE;
+    dirty_ = false;
+    modified_ = false;
+
+    // Reopens either the compacted file, or the current one on failure
+    if (!Load()) {
+      Close();
+      result = false;
+    }
+  }
+
+  if (!result)
+    ::DeleteFile(temp_path.c_str());
+
+  return result;
+}
+
+}  // namespace win
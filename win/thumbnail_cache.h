@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <windows.h>
+
+#include "surface.h"
+#include "thread.h"
+
+namespace win {
+
+// A persistent cache of decoded thumbnails, kept in a single memory-mapped
+// pack file. Records are appended to the file, and the index is written after
+// the last record when the cache is flushed. If the application exits before
+// that, the index is rebuilt from the records the next time the file is
+// opened. Entries are keyed by the source path and the requested size, and
+// are only returned while the size and last write time of the source file
+// match.
+
+class ThumbnailCache {
+public:
+  ThumbnailCache();
+  ~ThumbnailCache();
+
+  bool Open(const std::wstring& path, ULONGLONG max_size = 256 * 1024 * 1024);
+  void Close();
+  bool Flush();
+  bool IsOpen() const;
+
+  bool Get(const std::wstring& file, UINT width, UINT height,
+           Surface& surface);
+  bool Put(const std::wstring& file, UINT width, UINT height,
+           const Surface& surface);
+  bool Remove(const std::wstring& file, UINT width, UINT height);
+
+  // Drops replaced and removed records. If the cache is over the maximum
+  // size, the least recently used entries are dropped as well.
+  bool Compact();
+  void SetMaxSize(ULONGLONG max_size);
+  ULONGLONG GetSize() const;
+
+private:
+  struct Entry {
+    ULONGLONG record_offset;
+    ULONGLONG record_size;
+    ULONGLONG source_size;
+    ULONGLONG source_time;
+    DWORD last_use;
+  };
+
+  typedef std::tuple<std::wstring, UINT, UINT> Key;
+
+  bool Load();
+  bool Map(ULONGLONG size);
+  void Unmap();
+  bool Initialize();
+  bool ReadIndex();
+  void RebuildIndex();
+  void BuildIndex(const std::map<Key, Entry>& entries,
+                  std::vector<BYTE>& output) const;
+  bool WriteIndex();
+  void MarkDirty();
+  bool Reserve(ULONGLONG size);
+  bool CompactTo(ULONGLONG size);
+
+  std::wstring path_;
+  HANDLE file_;
+  HANDLE mapping_;
+  BYTE* view_;
+  ULONGLONG capacity_;
+  ULONGLONG data_end_;
+  ULONGLONG live_size_;
+  ULONGLONG max_size_;
+  DWORD use_counter_;
+  bool dirty_;
+  bool modified_;
+
+  std::map<Key, Entry> entries_;
+  mutable CriticalSection critical_section_;
+};
+
+}  // namespace win
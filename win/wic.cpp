@@ -0,0 +1,254 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma comment(lib, "windowscodecs.lib")
+
+#include <memory>
+#include <vector>
+
+#include <wincodec.h>
+
+#include "handle.h"
+#include "resample.h"
+#include "wic.h"
+
+namespace win {
+
+struct ComRelease {
+  void operator()(IUnknown* object) const {
+    object->Release();
+  }
+};
+
+template <typename T>
+using ComObject = std::unique_ptr<T, ComRelease>;
+
+// Creating the factory is costly, so each thread keeps the one it creates.
+// The pointer is trivially destructible, so that nothing is released after
+// the thread has uninitialized COM.
+IWICImagingFactory*& GetThreadImagingFactory() {
+  thread_local IWICImagingFactory* factory = nullptr;
+  return factory;
+}
+
+IWICImagingFactory* GetImagingFactory() {
+  IWICImagingFactory*& factory = GetThreadImagingFactory();
+  if (!factory)
+    ::CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                       IID_PPV_ARGS(&factory));
+  return factory;
+}
+
+UINT GetBitsPerPixel(IWICImagingFactory* factory,
+                     REFWICPixelFormatGUID format) {
+  IWICComponentInfo* component_info = nullptr;
+  if (FAILED(factory->CreateComponentInfo(format, &component_info)))
+    return 0;
+  ComObject<IWICComponentInfo> component(component_info);
+
+  IWICPixelFormatInfo* format_info = nullptr;
+  if (FAILED(component->QueryInterface(IID_PPV_ARGS(&format_info))))
+    return 0;
+  ComObject<IWICPixelFormatInfo> info(format_info);
+
+  UINT bits = 0;
+  info->GetBitsPerPixel(&bits);
+  return bits;
+}
+
+// Returns the frame decoded at the smallest size the codec supports that is
+// not smaller than the given size, or nullptr if the codec cannot scale.
+IWICBitmapSource* DecodeScaled(IWICImagingFactory* factory,
+                               IWICBitmapFrameDecode* frame,
+                               UINT width, UINT height) {
+  IWICBitmapSourceTransform* source_transform = nullptr;
+  if (FAILED(frame->QueryInterface(IID_PPV_ARGS(&source_transform))))
+    return nullptr;
+  ComObject<IWICBitmapSourceTransform> transform(source_transform);
+
+  UINT frame_width = 0;
+  UINT frame_height = 0;
+  frame->GetSize(&frame_width, &frame_height);
+
+  UINT scaled_width = width;
+  UINT scaled_height = height;
+  if (FAILED(transform->GetClosestSize(&scaled_width, &scaled_height)) ||
+      scaled_width < width || scaled_height < height ||
+      scaled_width >= frame_width || scaled_height >= frame_height)
+    return nullptr;
+
+  WICPixelFormatGUID format = GUID_WICPixelFormat32bppPBGRA;
+  if (FAILED(transform->GetClosestPixelFormat(&format)))
+    return nullptr;
+  const UINT bits = GetBitsPerPixel(factory, format);
+  if (!bits)
+    return nullptr;
+
+  const UINT stride = (scaled_width * bits + 7) / 8;
+  std::vector<BYTE> buffer(stride * scaled_height);
+  if (FAILED(transform->CopyPixels(nullptr, scaled_width, scaled_height,
+                                   &format, WICBitmapTransformRotate0,
+                                   stride, static_cast<UINT>(buffer.size()),
+                                   buffer.data())))
+    return nullptr;
+
+  IWICBitmap* bitmap = nullptr;
+  factory->CreateBitmapFromMemory(scaled_width, scaled_height, format,
+                                  stride, static_cast<UINT>(buffer.size()),
+                                  buffer.data(), &bitmap);
+  return bitmap;
+}
+
+bool DecodeFrame(IWICImagingFactory* factory, IWICBitmapDecoder* decoder,
+                 UINT width, UINT height, Surface& surface) {
+  IWICBitmapFrameDecode* frame_decode = nullptr;
+  if (FAILED(decoder->GetFrame(0, &frame_decode)))
+    return false;
+  ComObject<IWICBitmapFrameDecode> frame(frame_decode);
+
+  UINT frame_width = 0;
+  UINT frame_height = 0;
+  if (FAILED(frame->GetSize(&frame_width, &frame_height)))
+    return false;
+  if (width == 0)
+    width = frame_width;
+  if (height == 0)
+    height = frame_height;
+
+  ComObject<IWICBitmapSource> scaled(
+      DecodeScaled(factory, frame.get(), width, height));
+  IWICBitmapSource* source = scaled ? scaled.get() : frame.get();
+
+  IWICBitmapSource* converted_source = nullptr;
+  if (FAILED(::WICConvertBitmapSource(GUID_WICPixelFormat32bppPBGRA, source,
+                                      &converted_source)))
+    return false;
+  ComObject<IWICBitmapSource> converted(converted_source);
+
+  UINT source_width = 0;
+  UINT source_height = 0;
+  converted->GetSize(&source_width, &source_height);
+
+  if (!surface.Create(width, height))
+    return false;
+
+  if (source_width == width && source_height == height) {
+    const UINT stride = surface.GetStride();
+    return SUCCEEDED(converted->CopyPixels(
+        nullptr, stride, stride * height,
+        reinterpret_cast<BYTE*>(surface.GetPixels())));
+  }
+
+  const UINT source_stride = source_width * 4;
+  std::vector<uint32_t> pixels(static_cast<size_t>(source_width) *
+                               source_height);
+  if (FAILED(converted->CopyPixels(
+          nullptr, source_stride, source_stride * source_height,
+          reinterpret_cast<BYTE*>(pixels.data()))))
+    return false;
+
+  return ResamplePixels(surface.GetPixels(), surface.GetStride(),
+                        width, height, pixels.data(), source_stride,
+                        source_width, source_height);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DecodeImage(const std::wstring& file, UINT width, UINT height,
+                 Surface& surface) {
+  HANDLE file_handle = ::CreateFile(file.c_str(), GENERIC_READ,
+                                    FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  HANDLE mapping_handle = nullptr;
+  LARGE_INTEGER file_size = {0};
+
+  {
+    // The mapping keeps its own reference to the file
+    Handle file(file_handle);
+
+    if (!::GetFileSizeEx(file, &file_size) ||
+        file_size.QuadPart == 0 || file_size.QuadPart > MAXDWORD)
+      return false;
+
+    mapping_handle = ::CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0,
+                                         nullptr);
+    if (!mapping_handle)
+      return false;
+  }
+
+  Handle mapping(mapping_handle);
+  auto view = static_cast<const BYTE*>(
+      ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!view)
+    return false;
+
+  bool result = DecodeImage(view, static_cast<size_t>(file_size.QuadPart),
+                            width, height, surface);
+
+  ::UnmapViewOfFile(view);
+  return result;
+}
+
+bool DecodeImage(const BYTE* data, size_t size, UINT width, UINT height,
+                 Surface& surface) {
+  if (!data || size == 0 || size > MAXDWORD)
+    return false;
+
+  IWICImagingFactory* factory = GetImagingFactory();
+  if (!factory)
+    return false;
+
+  IWICStream* wic_stream = nullptr;
+  if (FAILED(factory->CreateStream(&wic_stream)))
+    return false;
+  ComObject<IWICStream> stream(wic_stream);
+
+  // The stream does not copy or modify the data
+  if (FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(data),
+                                          static_cast<DWORD>(size))))
+    return false;
+
+  IWICBitmapDecoder* bitmap_decoder = nullptr;
+  if (FAILED(factory->CreateDecoderFromStream(
+          stream.get(), nullptr, WICDecodeMetadataCacheOnDemand,
+          &bitmap_decoder)))
+    return false;
+  ComObject<IWICBitmapDecoder> decoder(bitmap_decoder);
+
+  return DecodeFrame(factory, decoder.get(), width, height, surface);
+}
+
+void ReleaseImagingFactory() {
+  IWICImagingFactory*& factory = GetThreadImagingFactory();
+  if (factory) {
+    factory->Release();
+    factory = nullptr;
+  }
+}
+
+}  // namespace win
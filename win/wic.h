@@ -0,0 +1,51 @@
+/*
+MIT License
+
+Copyright (c) 2010-2018 Eren Okka
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <windows.h>
+
+#include "surface.h"
+
+namespace win {
+
+// Image decoding through the Windows Imaging Component (WIC). COM must be
+// initialized on the calling thread. The imaging factory is created once per
+// thread, and a thread that uninitializes COM must call ReleaseImagingFactory
+// first. Otherwise the factory is leaked when the thread exits.
+
+// Decodes the first frame of an image into a premultiplied surface. When a
+// size is given, codecs that can scale while decoding (e.g. JPEG) reduce the
+// image first, and the rest is resampled. Zero keeps the original dimension.
+// Files are memory-mapped, so that the codec reads them without a copy.
+bool DecodeImage(const std::wstring& file, UINT width, UINT height,
+                 Surface& surface);
+bool DecodeImage(const BYTE* data, size_t size, UINT width, UINT height,
+                 Surface& surface);
+
+void ReleaseImagingFactory();
+
+}  // namespace win
@@ -22,26 +22,65 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
+#include <map>
 #include <vector>
 
 #include <windows.h>
 #include <uxtheme.h>
 #include <windowsx.h>
 
+#include "gdi.h"
+#include "icon_cache.h"
+#include "layered_window.h"
+#include "retained_paint.h"
 #include "taskbar.h"
 #include "window.h"
 #include "window_map.h"
 
+#ifndef WM_DPICHANGED
+#define WM_DPICHANGED 0x02E0
+#endif
+
 namespace win {
 
 const std::wstring kDefaultClassName = L"DefaultW";
 
+// Buffered paint must be initialized once on each thread that uses it
+class BufferedPaintThread {
+public:
+  BufferedPaintThread() : initialized_(SUCCEEDED(::BufferedPaintInit())) {}
+  ~BufferedPaintThread() {
+    if (initialized_)
+      ::BufferedPaintUnInit();
+  }
+  bool initialized() const { return initialized_; }
+
+private:
+  bool initialized_;
+};
+
+bool InitBufferedPaint() {
+  thread_local BufferedPaintThread buffered_paint_thread;
+  return buffered_paint_thread.initialized();
+}
+
+// Windows with deferred invalidations on the current thread
+std::vector<Window*>& GetDirtyWindows() {
+  thread_local std::vector<Window*> dirty_windows;
+  return dirty_windows;
+}
+
 Window* Window::current_window_ = nullptr;
 
 Window::Window()
-    : instance_(::GetModuleHandle(nullptr)),
+    : buffered_paint_(false),
+      retained_paint_(false),
+      instance_(::GetModuleHandle(nullptr)),
       font_(nullptr), icon_large_(nullptr), icon_small_(nullptr),
-      menu_(nullptr), parent_(nullptr), window_(nullptr) {
+      menu_(nullptr), parent_(nullptr), window_(nullptr),
+      dirty_erase_(FALSE),
+      content_version_(0) {
   current_window_ = nullptr;
 
   ::ZeroMemory(&create_struct_, sizeof(CREATESTRUCT));
@@ -62,15 +101,26 @@ Window::Window()
 }
 
 Window::Window(HWND hwnd)
-    : instance_(::GetModuleHandle(nullptr)),
+    : buffered_paint_(false),
+      retained_paint_(false),
+      instance_(::GetModuleHandle(nullptr)),
       font_(nullptr), icon_large_(nullptr), icon_small_(nullptr),
-      menu_(nullptr), parent_(nullptr), window_(nullptr) {
+      menu_(nullptr), parent_(nullptr), window_(nullptr),
+      dirty_erase_(FALSE),
+      content_version_(0) {
   current_window_ = nullptr;
   window_ = hwnd;
 }
 
 Window::~Window() {
   Destroy();
+
+  if (dirty_region_) {
+    auto& dirty_windows = GetDirtyWindows();
+    dirty_windows.erase(std::remove(dirty_windows.begin(),
+                                    dirty_windows.end(), this),
+                        dirty_windows.end());
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -143,15 +193,16 @@ void Window::Destroy() {
     ::DestroyWindow(window_);
 
   if (font_ && parent_) {
+    RemoveFontFromTextCaches(font_);
     ::DeleteObject(font_);
     font_ = nullptr;
   }
   if (icon_large_) {
-    ::DestroyIcon(icon_large_);
+    ReleaseIcon(icon_large_);
     icon_large_ = nullptr;
   }
   if (icon_small_) {
-    ::DestroyIcon(icon_small_);
+    ReleaseIcon(icon_small_);
     icon_small_ = nullptr;
   }
 
@@ -284,7 +335,7 @@ HWND Window::GetParentHandle() const {
 
 HICON Window::SetIconLarge(HICON icon) {
   if (icon_large_)
-    ::DestroyIcon(icon_large_);
+    ReleaseIcon(icon_large_);
 
   icon_large_ = icon;
 
@@ -296,15 +347,12 @@ HICON Window::SetIconLarge(HICON icon) {
 }
 
 HICON Window::SetIconLarge(int icon) {
-  return SetIconLarge(reinterpret_cast<HICON>(LoadImage(
-      instance_, MAKEINTRESOURCE(icon), IMAGE_ICON,
-      ::GetSystemMetrics(SM_CXICON), ::GetSystemMetrics(SM_CYICON),
-      LR_DEFAULTCOLOR)));
+  return SetIconLarge(GetIconCache().Load(instance_, icon, kIconLarge));
 }
 
 HICON Window::SetIconSmall(HICON icon) {
   if (icon_small_)
-    ::DestroyIcon(icon_small_);
+    ReleaseIcon(icon_small_);
 
   icon_small_ = icon;
 
@@ -316,10 +364,7 @@ HICON Window::SetIconSmall(HICON icon) {
 }
 
 HICON Window::SetIconSmall(int icon) {
-  return SetIconSmall(reinterpret_cast<HICON>(LoadImage(
-      instance_, MAKEINTRESOURCE(icon), IMAGE_ICON,
-      ::GetSystemMetrics(SM_CXSMICON), ::GetSystemMetrics(SM_CYSMICON),
-      LR_DEFAULTCOLOR)));
+  return SetIconSmall(GetIconCache().Load(instance_, icon, kIconSmall));
 }
 
 HWND Window::GetWindowHandle() const {
@@ -330,6 +375,51 @@ void Window::SetWindowHandle(HWND hwnd) {
   window_ = hwnd;
 }
 
+void Window::FlushInvalidations() {
+  // Swapped out first, as painting may defer new invalidations
+  std::vector<Window*> dirty_windows;
+  dirty_windows.swap(GetDirtyWindows());
+
+  for (auto window : dirty_windows)
+    window->FlushInvalidation();
+}
+
+void Window::FlushInvalidation() {
+  if (!dirty_region_ || dirty_region_->IsEmpty())
+    return;
+
+  if (::IsWindow(window_))
+    for (const auto& rect : dirty_region_->GetRects())
+      ::InvalidateRect(window_, &rect, dirty_erase_);
+
+  dirty_region_->Clear();
+  dirty_erase_ = FALSE;
+}
+
+void Window::SetBufferedPaint(bool enable) {
+  buffered_paint_ = enable;
+  if (!enable)
+    back_buffer_.reset();
+}
+
+void Window::SetRetainedPaint(bool enable) {
+  retained_paint_ = enable;
+  if (!enable)
+    GetRetainedPaintCache().Remove(window_);
+}
+
+void Window::InvalidateContent(LPCRECT rect) {
+  if (!rect) {
+    ++content_version_;
+  } else {
+    auto entry = GetRetainedPaintCache().Peek(window_);
+    if (entry)
+      entry->stale.Add(*rect);
+  }
+
+  ::InvalidateRect(window_, rect, FALSE);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Win32 API wrappers
 
@@ -426,6 +516,29 @@ BOOL Window::InvalidateRect(LPCRECT rect, BOOL erase) const {
   return ::InvalidateRect(window_, rect, erase);
 }
 
+void Window::InvalidateRectDeferred(LPCRECT rect, BOOL erase) {
+  Rect dirty;
+  if (rect) {
+    dirty = *rect;
+  } else if (!::GetClientRect(window_, &dirty)) {
+    return;
+  }
+
+  if (!dirty_region_)
+    dirty_region_.reset(new DirtyRegion);
+
+  if (dirty_region_->IsEmpty()) {
+    auto& dirty_windows = GetDirtyWindows();
+    if (std::find(dirty_windows.begin(), dirty_windows.end(), this) ==
+        dirty_windows.end())
+      dirty_windows.push_back(this);
+  }
+
+  dirty_region_->Add(dirty);
+  if (erase)
+    dirty_erase_ = TRUE;
+}
+
 BOOL Window::IsEnabled() const {
   return ::IsWindowEnabled(window_);
 }
@@ -506,8 +619,10 @@ void Window::SetFont(LPCWSTR face_name, int size,
   logfont.lfWeight = bold ? FW_BOLD : FW_NORMAL;
   logfont.lfUnderline = underline;
 
-  if (font_)
+  if (font_) {
+    RemoveFontFromTextCaches(font_);
     ::DeleteObject(font_);
+  }
   font_ = ::CreateFontIndirect(&logfont);
   SendMessage(WM_SETFONT, reinterpret_cast<WPARAM>(font_), TRUE);
 
@@ -603,6 +718,17 @@ BOOL Window::Update() const {
   return ::UpdateWindow(window_);
 }
 
+// Per-pixel alpha replaces SetLayeredWindowAttributes for the window
+BOOL Window::UpdateLayered(LayeredSurface& surface, const POINT* position,
+                           BYTE alpha) const {
+  if (!(GetWindowLong(GWL_EXSTYLE) & WS_EX_LAYERED)) {
+    SetStyle(WS_EX_LAYERED, 0, GWL_EXSTYLE);
+    surface.Invalidate();
+  }
+
+  return surface.Update(window_, position, alpha);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Window::OnCreate(HWND hwnd, LPCREATESTRUCT create_struct) {
@@ -614,6 +740,159 @@ void Window::OnCreate(HWND hwnd, LPCREATESTRUCT create_struct) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void Window::PaintWindow(HWND hwnd) {
+  FlushInvalidation();
+
+  if (!::GetUpdateRect(hwnd, nullptr, FALSE)) {
+    HDC hdc = ::GetDC(hwnd);
+    OnPaint(hdc, nullptr);
+    ::ReleaseDC(hwnd, hdc);
+    return;
+  }
+
+  PAINTSTRUCT ps;
+  HDC hdc = ::BeginPaint(hwnd, &ps);
+
+  if (retained_paint_ && !::IsRectEmpty(&ps.rcPaint) &&
+      PaintRetained(hwnd, ps)) {
+    ::EndPaint(hwnd, &ps);
+    return;
+  }
+
+  if (!buffered_paint_ || ::IsRectEmpty(&ps.rcPaint)) {
+    OnPaint(hdc, &ps);
+    ::EndPaint(hwnd, &ps);
+    return;
+  }
+
+  PAINTSTRUCT buffered_ps = ps;
+  buffered_ps.fErase = FALSE;
+
+  HDC buffer_dc = nullptr;
+  HPAINTBUFFER paint_buffer = nullptr;
+  if (InitBufferedPaint())
+    paint_buffer = ::BeginBufferedPaint(hdc, &ps.rcPaint,
+                                        BPBF_COMPATIBLEBITMAP, nullptr,
+                                        &buffer_dc);
+
+  if (paint_buffer) {
+    buffered_ps.hdc = buffer_dc;
+    EraseBackground(hwnd, buffer_dc, ps.rcPaint);
+    OnPaint(buffer_dc, &buffered_ps);
+    ::EndBufferedPaint(paint_buffer, TRUE);
+  } else {
+    if (!back_buffer_)
+      back_buffer_.reset(new BackBuffer);
+    buffer_dc = back_buffer_->Begin(hdc, ps.rcPaint);
+    if (buffer_dc) {
+      buffered_ps.hdc = buffer_dc;
+      EraseBackground(hwnd, buffer_dc, ps.rcPaint);
+      OnPaint(buffer_dc, &buffered_ps);
+      back_buffer_->End();
+    } else {
+      OnPaint(hdc, &ps);
+    }
+  }
+
+  ::EndPaint(hwnd, &ps);
+}
+
+bool Window::PaintRetained(HWND hwnd, const PAINTSTRUCT& ps) {
+  Rect client;
+  if (!::GetClientRect(hwnd, &client) || client.IsEmpty())
+    return false;
+  const SIZE size = {client.Width(), client.Height()};
+
+  auto& cache = GetRetainedPaintCache();
+  auto entry = cache.Get(hwnd);
+  if (entry && (entry->version != content_version_ ||
+                entry->size.cx != size.cx || entry->size.cy != size.cy)) {
+    cache.Remove(hwnd);
+    entry = nullptr;
+  }
+
+  HDC mem_dc = ::CreateCompatibleDC(ps.hdc);
+  if (!mem_dc)
+    return false;
+
+  if (!entry) {
+    HBITMAP bitmap = ::CreateCompatibleBitmap(ps.hdc, size.cx, size.cy);
+    if (!bitmap) {
+      ::DeleteDC(mem_dc);
+      return false;
+    }
+    entry = &cache.Put(hwnd, bitmap, size, content_version_);
+    entry->stale.Add(client);
+  }
+
+  // The bitmap stays selected into the DC until we are done, so GDI refuses
+  // to delete it even if the entry is evicted while the window paints.
+  HBITMAP bitmap = entry->bitmap;
+  HGDIOBJ bitmap_old = ::SelectObject(mem_dc, bitmap);
+
+  // Only the stale parts of the content are rendered again
+  if (!entry->stale.IsEmpty()) {
+    const int saved_state = ::SaveDC(mem_dc);
+
+    HRGN region = ::CreateRectRgn(0, 0, 0, 0);
+    for (const auto& rect : entry->stale.GetRects()) {
+      HRGN rect_region = ::CreateRectRgnIndirect(&rect);
+      ::CombineRgn(region, region, rect_region, RGN_OR);
+      ::DeleteObject(rect_region);
+      EraseBackground(hwnd, mem_dc, rect);
+    }
+    ::SelectClipRgn(mem_dc, region);
+    ::DeleteObject(region);
+
+    PAINTSTRUCT retained_ps = ps;
+    retained_ps.hdc = mem_dc;
+    retained_ps.fErase = FALSE;
+    retained_ps.rcPaint = entry->stale.GetBounds();
+    OnPaint(mem_dc, &retained_ps);
+
+    ::RestoreDC(mem_dc, saved_state);
+
+    // Painting may have evicted or replaced the entry
+    entry = cache.Peek(hwnd);
+    if (entry && entry->bitmap == bitmap)
+      entry->stale.Clear();
+  }
+
+  ::BitBlt(ps.hdc, ps.rcPaint.left, ps.rcPaint.top,
+           ps.rcPaint.right - ps.rcPaint.left,
+           ps.rcPaint.bottom - ps.rcPaint.top,
+           mem_dc, ps.rcPaint.left, ps.rcPaint.top, SRCCOPY);
+
+  ::SelectObject(mem_dc, bitmap_old);
+  ::DeleteDC(mem_dc);
+
+  // An evicted bitmap could not be deleted while it was selected
+  if (!entry || entry->bitmap != bitmap)
+    ::DeleteObject(bitmap);
+
+  return true;
+}
+
+// Controls that are mapped to a Window get the first chance to handle their
+// own notifications, before the parent does.
+BOOL Window::ReflectNotify(LPNMHDR nmh, LRESULT& result) const {
+  Window* control = window_map.GetWindow(nmh->hwndFrom);
+  if (!control || control == this)
+    return FALSE;
+
+  return control->OnReflectedNotify(nmh, result);
+}
+
+void Window::EraseBackground(HWND hwnd, HDC hdc, const RECT& rect) const {
+  HBRUSH brush = reinterpret_cast<HBRUSH>(
+      ::GetClassLongPtr(hwnd, GCLP_HBRBACKGROUND));
+  if (!brush)
+    brush = ::GetSysColorBrush(COLOR_BTNFACE);
+  ::FillRect(hdc, &rect, brush);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void Window::Subclass(HWND hwnd) {
   WNDPROC current_proc = reinterpret_cast<WNDPROC>(
       ::GetWindowLongPtr(hwnd, GWLP_WNDPROC));
@@ -675,14 +954,26 @@ LRESULT Window::WindowProcDefault(HWND hwnd, UINT uMsg,
       break;
     }
     case WM_DESTROY: {
+      GetRetainedPaintCache().Remove(hwnd);
       if (OnDestroy())
         return 0;
       break;
     }
+    case WM_DPICHANGED:
+    case WM_FONTCHANGE: {
+      // Cached text layouts and glyphs depend on the fonts and DPI in use
+      ClearTextCaches();
+      break;
+    }
     case WM_DROPFILES: {
       OnDropFiles(reinterpret_cast<HDROP>(wParam));
       break;
     }
+    case WM_ENTERIDLE: {
+      // Modal loops do not go through App::MessageLoop
+      FlushInvalidations();
+      break;
+    }
     case WM_ENTERSIZEMOVE:
     case WM_EXITSIZEMOVE: {
       SIZE size = {0};
@@ -716,28 +1007,35 @@ LRESULT Window::WindowProcDefault(HWND hwnd, UINT uMsg,
       break;
     }
     case WM_NOTIFY: {
-      LRESULT lResult = OnNotify(static_cast<int>(wParam),
-                                 reinterpret_cast<LPNMHDR>(lParam));
+      LRESULT lResult = 0;
+      if (ReflectNotify(reinterpret_cast<LPNMHDR>(lParam), lResult))
+        return lResult;
+      lResult = OnNotify(static_cast<int>(wParam),
+                         reinterpret_cast<LPNMHDR>(lParam));
       if (lResult)
         return lResult;
       break;
     }
+    case WM_ERASEBKGND: {
+      // The background is filled in the back buffer instead
+      if (buffered_paint_ && !prev_window_proc_)
+        return TRUE;
+      break;
+    }
     case WM_PAINT: {
-      if (!prev_window_proc_) {
-        if (::GetUpdateRect(hwnd, nullptr, FALSE)) {
-          PAINTSTRUCT ps;
-          HDC hdc = ::BeginPaint(hwnd, &ps);
-          OnPaint(hdc, &ps);
-          ::EndPaint(hwnd, &ps);
-        } else {
-          HDC hdc = ::GetDC(hwnd);
-          OnPaint(hdc, nullptr);
-          ::ReleaseDC(hwnd, hdc);
-        }
-      }
+      if (!prev_window_proc_)
+        PaintWindow(hwnd);
+      break;
+    }
+    case WM_SHOWWINDOW: {
+      // Hidden windows give up their retained content
+      if (!wParam)
+        GetRetainedPaintCache().Remove(hwnd);
       break;
     }
     case WM_SIZE: {
+      if (wParam == SIZE_MINIMIZED)
+        GetRetainedPaintCache().Remove(hwnd);
       SIZE size = {LOWORD(lParam), HIWORD(lParam)};
       OnSize(uMsg, static_cast<UINT>(wParam), size);
       break;
@@ -768,4 +1066,33 @@ LRESULT Window::WindowProcDefault(HWND hwnd, UINT uMsg,
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Windows are only redrawn from the thread that created them
+std::map<HWND, int>& GetRedrawGuardCounts() {
+  thread_local std::map<HWND, int> redraw_guard_counts;
+  return redraw_guard_counts;
+}
+
+RedrawGuard::RedrawGuard(HWND hwnd)
+    : hwnd_(hwnd) {
+  if (GetRedrawGuardCounts()[hwnd_]++ == 0)
+    ::SendMessage(hwnd_, WM_SETREDRAW, FALSE, 0);
+}
+
+RedrawGuard::~RedrawGuard() {
+  auto& counts = GetRedrawGuardCounts();
+  auto it = counts.find(hwnd_);
+  if (it == counts.end() || --it->second > 0)
+    return;
+
+  counts.erase(it);
+
+  if (::IsWindow(hwnd_)) {
+    ::SendMessage(hwnd_, WM_SETREDRAW, TRUE, 0);
+    ::RedrawWindow(hwnd_, nullptr, nullptr,
+                   RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+  }
+}
+
 }  // namespace win
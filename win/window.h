@@ -24,12 +24,17 @@ SOFTWARE.
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <windows.h>
 
 namespace win {
 
+class BackBuffer;
+class DirtyRegion;
+class LayeredSurface;
+
 enum WindowBorderStyle {
   kWindowBorderNone,
   kWindowBorderClient,
@@ -62,6 +67,19 @@ public:
   HWND    GetWindowHandle() const;
   void    SetWindowHandle(HWND hwnd);
 
+  // OnPaint receives an off-screen DC when buffered painting is enabled
+  void    SetBufferedPaint(bool enable);
+
+  // In retained paint mode, WM_PAINT is served from the last rendered content
+  // until InvalidateContent is called for the whole window or a part of it.
+  void    SetRetainedPaint(bool enable);
+  void    InvalidateContent(LPCRECT rect = nullptr);
+
+  // Invalidates the rectangles collected by InvalidateRectDeferred. Called by
+  // the message loop before it checks for new messages.
+  static void FlushInvalidations();
+  void    FlushInvalidation();
+
   // Win32 API wrappers
   BOOL    BringWindowToTop() const;
   BOOL    Close() const;
@@ -82,6 +100,7 @@ public:
   BOOL    Hide() const;
   BOOL    HideCaret() const;
   BOOL    InvalidateRect(LPCRECT rect = nullptr, BOOL erase = TRUE) const;
+  void    InvalidateRectDeferred(LPCRECT rect = nullptr, BOOL erase = TRUE);
   BOOL    IsEnabled() const;
   BOOL    IsIconic() const;
   BOOL    IsVisible() const;
@@ -110,6 +129,7 @@ public:
   BOOL    SetTransparency(BYTE alpha, COLORREF color = 0xFF000000) const;
   BOOL    Show(int cmd_show = SW_SHOWNORMAL) const;
   BOOL    Update() const;
+  BOOL    UpdateLayered(LayeredSurface& surface, const POINT* position = nullptr, BYTE alpha = 255) const;
 
 protected:
   // Message handlers
@@ -122,6 +142,7 @@ protected:
   virtual LRESULT OnMouseEvent(UINT uMsg, WPARAM wParam, LPARAM lParam) { return -1; }
   virtual void    OnMove(LPPOINTS pts) {}
   virtual LRESULT OnNotify(int control_id, LPNMHDR nmh) { return 0; }
+  virtual BOOL    OnReflectedNotify(LPNMHDR nmh, LRESULT& result) { return FALSE; }
   virtual void    OnPaint(HDC hdc, LPPAINTSTRUCT ps) {}
   virtual void    OnSize(UINT uMsg, UINT type, SIZE size) {}
   virtual void    OnTaskbarCallback(UINT uMsg, LPARAM lParam) {}
@@ -130,6 +151,11 @@ protected:
   virtual LRESULT WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
   virtual LRESULT WindowProcDefault(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+  void PaintWindow(HWND hwnd);
+  BOOL ReflectNotify(LPNMHDR nmh, LRESULT& result) const;
+
+  bool         buffered_paint_;
+  bool         retained_paint_;
   CREATESTRUCT create_struct_;
   WNDCLASSEX   window_class_;
   HINSTANCE    instance_;
@@ -142,11 +168,34 @@ protected:
 private:
   static LRESULT CALLBACK WindowProcStatic(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+  void EraseBackground(HWND hwnd, HDC hdc, const RECT& rect) const;
+  bool PaintRetained(HWND hwnd, const PAINTSTRUCT& ps);
   BOOL RegisterClass(WNDCLASSEX& wc) const;
   void Subclass(HWND hwnd);
   void UnSubclass();
 
+  std::unique_ptr<BackBuffer> back_buffer_;
+  std::unique_ptr<DirtyRegion> dirty_region_;
+  BOOL dirty_erase_;
+  UINT content_version_;
+
   static Window* current_window_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Suspends redrawing a window for its lifetime. Guards can be nested, and the
+// window is only redrawn when the outermost one is destroyed.
+class RedrawGuard {
+public:
+  explicit RedrawGuard(HWND hwnd);
+  ~RedrawGuard();
+
+private:
+  RedrawGuard(const RedrawGuard&) = delete;
+  RedrawGuard& operator=(const RedrawGuard&) = delete;
+
+  HWND hwnd_;
+};
+
 }  // namespace win